@@ -3,7 +3,21 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Most sectors merged into a single transfer. */
+#define MERGE_MAX 256
+
+/* Most I/O threads per device. */
+#define DEPTH_MAX 8
+
+/* Timer ticks a read or write may wait before the deadline
+   scheduler serves it ahead of the elevator order. */
+#define READ_EXPIRE (TIMER_FREQ / 20)
+#define WRITE_EXPIRE (TIMER_FREQ / 2)
 
 /* A block device. */
 struct block
@@ -19,6 +33,19 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    struct blockstat stats;             /* Other statistics. */
+
+    /* Request queue. */
+    struct lock queue_lock;             /* Protects the members below. */
+    struct condition queue_ready;       /* Signaled when SORTED grows. */
+    struct list sorted;                 /* Requests in sector order. */
+    struct list fifo[2];                /* Reads, writes in submit order. */
+    struct list inflight;               /* Dispatched, not yet finished. */
+    block_sector_t head;                /* Sector after last dispatched. */
+    unsigned long long next_seq;        /* Sequence number for next. */
+    int pending;                        /* Requests queued or in flight. */
+    int depth;                          /* Number of I/O threads. */
+    bool worker_started;                /* I/O threads started? */
   };
 
 /* List of all block devices. */
@@ -27,7 +54,29 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 /* The block block assigned to each Pintos role. */
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
+/* A traced request. */
+struct trace_entry
+  {
+    uint64_t cycles;                    /* CPU cycle count at submission. */
+    struct block *block;                /* Device. */
+    block_sector_t sector;              /* First sector. */
+    uint32_t cnt;                       /* Number of sectors. */
+    bool write;                         /* Write or read? */
+    tid_t tid;                          /* Submitting thread. */
+    char thread[16];                    /* Its name. */
+  };
+
+/* Trace of the most recent requests, in a ring buffer of
+   TRACE_SIZE entries of which TRACE_CNT have been used in all.
+   Null if tracing is disabled. */
+static struct trace_entry *trace;
+static size_t trace_size;
+static unsigned long long trace_cnt;
+static bool trace_to_scratch;           /* Dump to scratch device? */
+
 static struct block *list_elem_to_block (struct list_elem *);
+static void block_worker (void *block_);
+static void trace_request (struct block *, const struct block_request *);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -113,6 +162,121 @@ check_sector (struct block *block, block_sector_t sector)
     }
 }
 
+/* Verifies that the CNT sectors starting at SECTOR all lie
+   within BLOCK.  Panics if not. */
+static void
+check_sectors (struct block *block, block_sector_t sector, size_t cnt)
+{
+  check_sector (block, sector);
+  if (cnt > block->size - sector)
+    PANIC ("Access past end of device %s (sector=%"PRDSNu", cnt=%zu, "
+           "size=%"PRDSNu")\n", block_name (block), sector, cnt,
+           block->size);
+}
+
+/* Initializes REQ as a request to read (if WRITE is false) or
+   write the CNT sectors starting at SECTOR, to or from BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes.  If
+   DONE is non-null, it is called with REQ and AUX from the
+   device's I/O thread when the request finishes; otherwise, the
+   submitter waits for it with block_wait(). */
+void
+block_request_init (struct block_request *req, bool write,
+                    block_sector_t sector, size_t cnt, void *buffer,
+                    block_done_func *done, void *aux)
+{
+  ASSERT (cnt > 0);
+
+  req->write = write;
+  req->sector = sector;
+  req->cnt = cnt;
+  req->buffer = buffer;
+  req->done = done;
+  req->aux = aux;
+  sema_init (&req->finished, 0);
+}
+
+/* Adds REQ to BLOCK's queue and returns without waiting for it.
+   Starts BLOCK's I/O threads if this is its first request. */
+void
+block_submit (struct block *block, struct block_request *req)
+{
+  bool start;
+  struct list_elem *e;
+
+  check_sectors (block, req->sector, req->cnt);
+  ASSERT (!req->write || block->type != BLOCK_FOREIGN);
+  trace_request (block, req);
+
+  lock_acquire (&block->queue_lock);
+  req->seq = block->next_seq++;
+  req->deadline = timer_ticks () + (req->write ? WRITE_EXPIRE : READ_EXPIRE);
+  req->submitted = timer_cycles ();
+  for (e = list_begin (&block->sorted); e != list_end (&block->sorted);
+       e = list_next (e))
+    if (list_entry (e, struct block_request, elem)->sector > req->sector)
+      break;
+  list_insert (e, &req->elem);
+  list_push_back (&block->fifo[req->write], &req->fifo_elem);
+  if (req->write)
+    {
+      block->write_cnt += req->cnt;
+      block->stats.writes++;
+    }
+  else
+    {
+      block->read_cnt += req->cnt;
+      block->stats.reads++;
+    }
+  block->stats.depth[(block->pending < BLOCKSTAT_DEPTHS - 1
+                      ? block->pending : BLOCKSTAT_DEPTHS - 1)]++;
+  block->pending++;
+  start = !block->worker_started;
+  block->worker_started = true;
+  cond_signal (&block->queue_ready, &block->queue_lock);
+  lock_release (&block->queue_lock);
+
+  if (start)
+    {
+      char name[sizeof block->name + 3];
+      int i;
+
+      snprintf (name, sizeof name, "%s-io", block->name);
+      for (i = 0; i < block->depth; i++)
+        if (thread_create (name, PRI_MAX, block_worker, block) == TID_ERROR)
+          PANIC ("%s: failed to start I/O thread", block->name);
+    }
+}
+
+/* Lets BLOCK's driver carry out up to DEPTH requests at once, by
+   calling its operations from DEPTH threads.  Must be called
+   before BLOCK's first request. */
+void
+block_set_queue_depth (struct block *block, int depth)
+{
+  ASSERT (!block->worker_started);
+  ASSERT (depth >= 1);
+
+  block->depth = depth < DEPTH_MAX ? depth : DEPTH_MAX;
+}
+
+/* Returns the number of requests BLOCK's driver can carry out at
+   once. */
+int
+block_queue_depth (const struct block *block)
+{
+  return block->depth;
+}
+
+/* Waits for REQ, which must have been submitted without a
+   completion function, to finish. */
+void
+block_wait (struct block_request *req)
+{
+  ASSERT (req->done == NULL);
+  sema_down (&req->finished);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
@@ -120,9 +284,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  block_read_multiple (block, sector, 1, buffer);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +295,374 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  block_write_multiple (block, sector, 1, buffer);
+}
+
+/* Reads the CNT sectors starting at SECTOR from BLOCK into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Drivers that support it move the whole run with a
+   single command; others are called once per sector.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                     void *buffer)
+{
+  struct block_request req;
+
+  if (cnt == 0)
+    return;
+  block_request_init (&req, false, sector, cnt, buffer, NULL, NULL);
+  block_submit (block, &req);
+  block_wait (&req);
+}
+
+/* Writes the CNT sectors starting at SECTOR to BLOCK from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block device has acknowledged receiving all
+   of the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      size_t cnt, const void *buffer)
+{
+  struct block_request req;
+
+  if (cnt == 0)
+    return;
+  block_request_init (&req, true, sector, cnt, (void *) buffer, NULL, NULL);
+  block_submit (block, &req);
+  block_wait (&req);
+}
+
+/* Returns true if REQ must wait for a request in BLOCK's queue
+   that was submitted before it, or one still in flight, because
+   the two overlap and at least one of them is a write.  The
+   scheduler never reorders such requests. */
+static bool
+is_blocked (struct block *block, const struct block_request *req)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&block->inflight); e != list_end (&block->inflight);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request,
+                                            fifo_elem);
+      if (r->sector < req->sector + req->cnt
+          && r->sector + r->cnt > req->sector
+          && (r->write || req->write))
+        return true;
+    }
+
+  for (e = list_begin (&block->sorted); e != list_end (&block->sorted);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->sector >= req->sector + req->cnt)
+        break;
+      if (r->seq < req->seq && r->sector + r->cnt > req->sector
+          && (r->write || req->write))
+        return true;
+    }
+  return false;
+}
+
+/* C-LOOK elevator: serves requests in ascending sector order
+   from the last position of the disk head, then jumps back to
+   the lowest pending sector.  Returns null if every queued
+   request must wait for one in flight. */
+static struct block_request *
+clook_pick (struct block *block)
+{
+  struct block_request *wrap = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&block->sorted); e != list_end (&block->sorted);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (is_blocked (block, r))
+        continue;
+      if (r->sector >= block->head)
+        return r;
+      if (wrap == NULL)
+        wrap = r;
+    }
+  return wrap;
+}
+
+/* Deadline: serves the oldest read, then the oldest write, if
+   it has waited past its deadline, and otherwise works like
+   C-LOOK.  Reads expire much sooner than writes, since a thread
+   is usually waiting for them. */
+static struct block_request *
+deadline_pick (struct block *block)
+{
+  int64_t now = timer_ticks ();
+  int write;
+
+  for (write = 0; write < 2; write++)
+    if (!list_empty (&block->fifo[write]))
+      {
+        struct block_request *r = list_entry (list_front (&block->fifo[write]),
+                                              struct block_request,
+                                              fifo_elem);
+        if (now >= r->deadline && !is_blocked (block, r))
+          return r;
+      }
+  return clook_pick (block);
+}
+
+/* An I/O scheduler, which chooses the next request to dispatch,
+   or returns null if there is none that can go now. */
+struct block_scheduler
+  {
+    const char *name;
+    struct block_request *(*pick) (struct block *);
+  };
+
+static const struct block_scheduler schedulers[] =
+  {
+    {"clook", clook_pick},
+    {"deadline", deadline_pick},
+  };
+
+/* Scheduler in use for every block device. */
+static const struct block_scheduler *scheduler = &schedulers[0];
+
+/* Selects the I/O scheduler called NAME, either "clook" or
+   "deadline", for all block devices.  Returns false if there is
+   no such scheduler. */
+bool
+block_set_scheduler (const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof schedulers / sizeof *schedulers; i++)
+    if (!strcmp (name, schedulers[i].name))
+      {
+        scheduler = &schedulers[i];
+        return true;
+      }
+  return false;
+}
+
+/* Moves the next batch of requests from BLOCK's queue onto
+   BATCH, which must be empty, and marks them in flight: the
+   request the scheduler picks, merged with queued requests in
+   the same direction for the sectors just before and after it,
+   up to MERGE_MAX sectors in all.  The batch is in ascending
+   sector order.  Returns false, leaving BATCH empty, if no
+   request can be dispatched now. */
+static bool
+take_batch (struct block *block, struct list *batch)
+{
+  struct block_request *req = (list_empty (&block->sorted) ? NULL
+                               : scheduler->pick (block));
+  struct list_elem *first, *last;
+  block_sector_t start, end;
+  struct list_elem *e;
+
+  if (req == NULL)
+    return false;
+  first = last = &req->elem;
+  start = req->sector;
+  end = req->sector + req->cnt;
+
+  while (first != list_begin (&block->sorted))
+    {
+      struct block_request *r = list_entry (list_prev (first),
+                                            struct block_request, elem);
+      if (r->write != req->write || r->sector + r->cnt != start
+          || end - r->sector > MERGE_MAX || is_blocked (block, r))
+        break;
+      first = &r->elem;
+      start = r->sector;
+    }
+  while (list_next (last) != list_end (&block->sorted))
+    {
+      struct block_request *r = list_entry (list_next (last),
+                                            struct block_request, elem);
+      if (r->write != req->write || r->sector != end
+          || r->sector + r->cnt - start > MERGE_MAX || is_blocked (block, r))
+        break;
+      last = &r->elem;
+      end = r->sector + r->cnt;
+    }
+
+  list_splice (list_end (batch), first, list_next (last));
+  for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      list_remove (&r->fifo_elem);
+      list_push_back (&block->inflight, &r->fifo_elem);
+    }
+  block->stats.transfers++;
+  if (start == block->head)
+    block->stats.sequential++;
+  block->head = end;
+  return true;
+}
+
+/* Has BLOCK's driver transfer the CNT sectors starting at
+   SECTOR, in a single command if it supports that. */
+static void
+transfer (struct block *block, bool write, block_sector_t sector,
+          size_t cnt, void *buffer)
+{
+  uint8_t *p = buffer;
+  size_t i;
+
+  if (write && block->ops->write_multiple != NULL)
+    block->ops->write_multiple (block->aux, sector, cnt, buffer);
+  else if (!write && block->ops->read_multiple != NULL)
+    block->ops->read_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++, p += BLOCK_SECTOR_SIZE)
+      if (write)
+        block->ops->write (block->aux, sector + i, p);
+      else
+        block->ops->read (block->aux, sector + i, p);
+}
+
+/* Carries out the requests in BATCH, which cover consecutive
+   sectors, with one transfer: scatter/gather if the driver
+   supports it, otherwise through a bounce buffer.  Falls back to
+   one transfer per request if there is only one or memory for
+   the transfer cannot be allocated. */
+static void
+dispatch (struct block *block, struct list *batch)
+{
+  struct block_request *first = list_entry (list_front (batch),
+                                            struct block_request, elem);
+  struct block_request *last = list_entry (list_back (batch),
+                                           struct block_request, elem);
+  size_t cnt = last->sector + last->cnt - first->sector;
+  uint8_t *bounce = NULL, *p;
+  struct list_elem *e;
+
+  if (block->ops->transfer_sg != NULL)
+    {
+      struct block_segment *segs = malloc (list_size (batch) * sizeof *segs);
+      size_t seg_cnt = 0;
+
+      if (segs != NULL || first == last)
+        {
+          struct block_segment seg;
+          if (segs == NULL)
+            segs = &seg;
+          for (e = list_begin (batch); e != list_end (batch);
+               e = list_next (e))
+            {
+              struct block_request *r = list_entry (e, struct block_request,
+                                                    elem);
+              segs[seg_cnt].buffer = r->buffer;
+              segs[seg_cnt++].cnt = r->cnt;
+            }
+          block->ops->transfer_sg (block->aux, first->write, first->sector,
+                                   segs, seg_cnt);
+          if (segs != &seg)
+            free (segs);
+          return;
+        }
+    }
+
+  if (first != last)
+    bounce = malloc (cnt * BLOCK_SECTOR_SIZE);
+  if (bounce == NULL)
+    {
+      for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+        {
+          struct block_request *r = list_entry (e, struct block_request, elem);
+          transfer (block, r->write, r->sector, r->cnt, r->buffer);
+        }
+      return;
+    }
+
+  if (first->write)
+    for (e = list_begin (batch), p = bounce; e != list_end (batch);
+         e = list_next (e))
+      {
+        struct block_request *r = list_entry (e, struct block_request, elem);
+        memcpy (p, r->buffer, r->cnt * BLOCK_SECTOR_SIZE);
+        p += r->cnt * BLOCK_SECTOR_SIZE;
+      }
+  transfer (block, first->write, first->sector, cnt, bounce);
+  if (!first->write)
+    for (e = list_begin (batch), p = bounce; e != list_end (batch);
+         e = list_next (e))
+      {
+        struct block_request *r = list_entry (e, struct block_request, elem);
+        memcpy (r->buffer, p, r->cnt * BLOCK_SECTOR_SIZE);
+        p += r->cnt * BLOCK_SECTOR_SIZE;
+      }
+  free (bounce);
+}
+
+/* Returns the BLOCKSTAT_BUCKETS histogram bucket for CYCLES. */
+static int
+log2_bucket (uint64_t cycles)
+{
+  int bucket = 0;
+
+  while (cycles > 1 && bucket < BLOCKSTAT_BUCKETS - 1)
+    {
+      cycles >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
+
+/* One of BLOCK's I/O threads.  Repeatedly takes a batch of
+   requests from BLOCK's queue, carries it out, and completes its
+   requests. */
+static void
+block_worker (void *block_)
+{
+  struct block *block = block_;
+
+  for (;;)
+    {
+      struct list batch;
+      struct list_elem *e, *next;
+      uint64_t start, end;
+
+      list_init (&batch);
+      lock_acquire (&block->queue_lock);
+      while (!take_batch (block, &batch))
+        cond_wait (&block->queue_ready, &block->queue_lock);
+      lock_release (&block->queue_lock);
+
+      start = timer_cycles ();
+      dispatch (block, &batch);
+      end = timer_cycles ();
+
+      /* Requests that overlap these may go now. */
+      lock_acquire (&block->queue_lock);
+      block->stats.service[log2_bucket (end - start)]++;
+      for (e = list_begin (&batch); e != list_end (&batch); e = list_next (e))
+        {
+          struct block_request *r = list_entry (e, struct block_request, elem);
+          list_remove (&r->fifo_elem);
+          block->stats.queued[log2_bucket (start - r->submitted)]++;
+          block->pending--;
+        }
+      cond_broadcast (&block->queue_ready, &block->queue_lock);
+      lock_release (&block->queue_lock);
+
+      /* A waiter may free its request as soon as it is up'd. */
+      for (e = list_begin (&batch); e != list_end (&batch); e = next)
+        {
+          struct block_request *r = list_entry (e, struct block_request, elem);
+          next = list_next (e);
+          if (r->done != NULL)
+            r->done (r, r->aux);
+          else
+            sema_up (&r->finished);
+        }
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,15 +686,82 @@ block_type (struct block *block)
   return block->type;
 }
 
-/* Prints statistics for each block device used for a Pintos role. */
+/* Returns the AUX that BLOCK was registered with, if its driver
+   operations are OPS, otherwise a null pointer.  Lets a driver
+   recognize its own devices. */
+void *
+block_get_aux (struct block *block, const struct block_operations *ops)
+{
+  return block->ops == ops ? block->aux : NULL;
+}
+
+/* Returns the number of sectors read from BLOCK. */
+unsigned long long
+block_read_cnt (const struct block *block)
+{
+  return block->read_cnt;
+}
+
+/* Returns the number of sectors written to BLOCK. */
+unsigned long long
+block_write_cnt (const struct block *block)
+{
+  return block->write_cnt;
+}
+
+/* Copies BLOCK's statistics into *ST, without locking. */
+static void
+copy_stats (struct block *block, struct blockstat *st)
+{
+  *st = block->stats;
+  strlcpy (st->name, block->name, sizeof st->name);
+  strlcpy (st->role, block_type_name (block->type), sizeof st->role);
+  st->cycles_per_tick = timer_cycles_per_tick ();
+  st->read_bytes = block->read_cnt * BLOCK_SECTOR_SIZE;
+  st->write_bytes = block->write_cnt * BLOCK_SECTOR_SIZE;
+}
+
+/* Copies BLOCK's statistics into *ST. */
+void
+block_get_stats (struct block *block, struct blockstat *st)
+{
+  lock_acquire (&block->queue_lock);
+  copy_stats (block, st);
+  lock_release (&block->queue_lock);
+}
+
+/* Prints LABEL followed by the nonempty buckets of the CNT-bucket
+   histogram HIST, with the bucket numbers formatted by FORMAT. */
+static void
+print_histogram (const char *label, const char *format,
+                 const uint64_t *hist, int cnt)
+{
+  int i;
+
+  printf ("  %s:", label);
+  for (i = 0; i < cnt; i++)
+    if (hist[i] != 0)
+      {
+        printf (format, i);
+        printf ("=%"PRIu64, hist[i]);
+      }
+  printf ("\n");
+}
+
+/* Prints statistics for each block device used for a Pintos
+   role, followed by detailed statistics for every block device
+   that has been used.  A partition's service times include
+   queuing at the disk that holds it, which has statistics of its
+   own. */
 void
 block_print_stats (void)
 {
+  struct block *block;
   int i;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++)
     {
-      struct block *block = block_by_role[i];
+      block = block_by_role[i];
       if (block != NULL)
         {
           printf ("%s (%s): %llu reads, %llu writes\n",
@@ -176,6 +769,172 @@ block_print_stats (void)
                   block->read_cnt, block->write_cnt);
         }
     }
+
+  for (block = block_first (); block != NULL; block = block_next (block))
+    {
+      struct blockstat st;
+      uint64_t lock_wait_ms;
+
+      /* We may be shutting down from a panic, so don't lock. */
+      copy_stats (block, &st);
+      if (st.transfers == 0)
+        continue;
+      lock_wait_ms = (st.cycles_per_tick == 0 ? 0
+                      : st.lock_wait / st.cycles_per_tick * 1000 / TIMER_FREQ);
+      printf ("%s: %'"PRIu64" bytes read, %'"PRIu64" bytes written, "
+              "%"PRIu64" transfers, %"PRIu64"%% sequential, "
+              "%"PRIu64" ms waiting for controller\n",
+              st.name, st.read_bytes, st.write_bytes, st.transfers,
+              st.sequential * 100 / st.transfers, lock_wait_ms);
+      print_histogram ("service time (log2 cycles)", " %d", st.service,
+                       BLOCKSTAT_BUCKETS);
+      print_histogram ("queue time (log2 cycles)", " %d", st.queued,
+                       BLOCKSTAT_BUCKETS);
+      print_histogram ("queue depth", " %d", st.depth, BLOCKSTAT_DEPTHS);
+    }
+}
+
+/* Starts recording the CNT most recent requests to any block
+   device, to be written out by block_trace_dump() to the scratch
+   device if TO_SCRATCH is true, or else to the console. */
+void
+block_trace_init (size_t cnt, bool to_scratch)
+{
+  ASSERT (cnt > 0);
+
+  trace = malloc (cnt * sizeof *trace);
+  if (trace == NULL)
+    PANIC ("failed to allocate %zu-entry block trace", cnt);
+  trace_size = cnt;
+  trace_cnt = 0;
+  trace_to_scratch = to_scratch;
+}
+
+/* Records REQ, which is being submitted to BLOCK, in the trace,
+   if tracing is enabled. */
+static void
+trace_request (struct block *block, const struct block_request *req)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level = intr_disable ();
+  struct trace_entry *e;
+
+  if (trace == NULL)
+    {
+      intr_set_level (old_level);
+      return;
+    }
+  e = &trace[trace_cnt++ % trace_size];
+  e->cycles = timer_cycles ();
+  e->block = block;
+  e->sector = req->sector;
+  e->cnt = req->cnt;
+  e->write = req->write;
+  e->tid = t->tid;
+  strlcpy (e->thread, t->name, sizeof e->thread);
+  intr_set_level (old_level);
+}
+
+/* Formats line number LINE of trace T, in which CNT entries
+   have been used in all, into BUF, which has room for SIZE
+   bytes, and returns its length.  Line 0 is a header and the
+   rest are the recorded requests, oldest first, one per line. */
+static size_t
+format_trace_line (const struct trace_entry *t, unsigned long long cnt,
+                   unsigned long long line, char *buf, size_t size)
+{
+  unsigned long long first = cnt > trace_size ? cnt - trace_size : 0;
+  const struct trace_entry *e;
+  int len;
+
+  if (line == 0)
+    len = snprintf (buf, size, "blktrace: %"PRIu64" cycles/tick, "
+                    "%llu requests, %llu dropped\n",
+                    timer_cycles_per_tick (), cnt, first);
+  else
+    {
+      e = &t[(first + line - 1) % trace_size];
+      len = snprintf (buf, size, "blktrace: %"PRIu64" %s %c %"PRDSNu
+                      " %"PRIu32" %d %s\n",
+                      e->cycles, e->block->name, e->write ? 'W' : 'R',
+                      e->sector, e->cnt, e->tid, e->thread);
+    }
+  return (size_t) len < size ? (size_t) len : size - 1;
+}
+
+/* Writes out the trace started by block_trace_init() and stops
+   tracing.  The trace goes to the scratch device if that was
+   requested and possible, as text padded with null bytes, or
+   otherwise to the console.  Either way, "utils/pintos-blktrace"
+   can read it back. */
+void
+block_trace_dump (void)
+{
+  unsigned long long cnt, line_cnt, line;
+  struct trace_entry *t;
+  struct block *scratch;
+  enum intr_level old_level;
+  char text[128];
+
+  /* Stop tracing, so that no request is traced into the buffer
+     while or after we free it, nor our own writes traced. */
+  old_level = intr_disable ();
+  t = trace;
+  cnt = trace_cnt;
+  trace = NULL;
+  intr_set_level (old_level);
+  if (t == NULL)
+    return;
+  line_cnt = (cnt < trace_size ? cnt : trace_size) + 1;
+
+  /* Writing to the scratch device needs its I/O threads to run,
+     which they cannot if we are shutting down from a panic. */
+  scratch = block_get_role (BLOCK_SCRATCH);
+  if (trace_to_scratch && scratch != NULL
+      && intr_get_level () == INTR_ON && !intr_context ())
+    {
+      uint8_t *sector = malloc (BLOCK_SECTOR_SIZE);
+      block_sector_t sector_idx = 0;
+      size_t ofs = 0;
+
+      if (sector != NULL)
+        {
+          for (line = 0; line < line_cnt; line++)
+            {
+              size_t len = format_trace_line (t, cnt, line,
+                                              text, sizeof text);
+              size_t i;
+
+              for (i = 0; i < len && sector_idx < block_size (scratch); i++)
+                {
+                  sector[ofs++] = text[i];
+                  if (ofs == BLOCK_SECTOR_SIZE)
+                    {
+                      block_write (scratch, sector_idx++, sector);
+                      ofs = 0;
+                    }
+                }
+            }
+          /* Terminate with a null byte. */
+          if (sector_idx < block_size (scratch))
+            {
+              memset (sector + ofs, 0, BLOCK_SECTOR_SIZE - ofs);
+              block_write (scratch, sector_idx++, sector);
+            }
+          printf ("%s: wrote %llu-line block trace in %"PRDSNu" sectors\n",
+                  scratch->name, line_cnt, sector_idx);
+          free (sector);
+          free (t);
+          return;
+        }
+    }
+
+  for (line = 0; line < line_cnt; line++)
+    {
+      format_trace_line (t, cnt, line, text, sizeof text);
+      printf ("%s", text);
+    }
+  free (t);
 }
 
 /* Registers a new block device with the given NAME.  If
@@ -200,6 +959,18 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  lock_init (&block->queue_lock);
+  cond_init (&block->queue_ready);
+  list_init (&block->sorted);
+  list_init (&block->fifo[0]);
+  list_init (&block->fifo[1]);
+  list_init (&block->inflight);
+  block->head = 0;
+  block->next_seq = 0;
+  block->pending = 0;
+  memset (&block->stats, 0, sizeof block->stats);
+  block->depth = 1;
+  block->worker_started = false;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -210,6 +981,16 @@ block_register (const char *name, enum block_type type,
 
   return block;
 }
+
+/* Adds CYCLES to the time BLOCK's driver has spent waiting for
+   a controller that BLOCK shares with other devices. */
+void
+block_add_lock_wait (struct block *block, uint64_t cycles)
+{
+  lock_acquire (&block->queue_lock);
+  block->stats.lock_wait += cycles;
+  lock_release (&block->queue_lock);
+}
 
 /* Returns the block device corresponding to LIST_ELEM, or a null
    pointer if LIST_ELEM is the list end of all_blocks. */
@@ -3,6 +3,9 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <blockstat.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,22 +56,109 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, size_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, size_t cnt,
+                           const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* Asynchronous requests.
+
+   Each block device has a queue of pending requests, served in
+   the order chosen by the I/O scheduler by a kernel thread of its
+   own.  Requests for adjacent sectors are merged into a single
+   transfer when they are dispatched.  block_read(),
+   block_write() and their multi-sector forms are built on these
+   and simply wait for their request to finish. */
+
+struct block_request;
+
+/* Called by the device's I/O thread when REQ has finished. */
+typedef void block_done_func (struct block_request *req, void *aux);
+
+/* A request to read or write a run of consecutive sectors.
+   Members are private to the block layer once submitted. */
+struct block_request
+  {
+    struct list_elem elem;       /* Element in queue's sorted list. */
+    struct list_elem fifo_elem;  /* Element in queue's FIFO list. */
+    bool write;                  /* True to write, false to read. */
+    block_sector_t sector;       /* First sector. */
+    size_t cnt;                  /* Number of sectors. */
+    void *buffer;                /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    unsigned long long seq;      /* Submission order. */
+    int64_t deadline;            /* Timer tick by which it is due. */
+    uint64_t submitted;          /* CPU cycle count when submitted. */
+    block_done_func *done;       /* Completion function, or null. */
+    void *aux;                   /* Passed to DONE. */
+    struct semaphore finished;   /* Up'd on completion if DONE is null. */
+  };
+
+void block_request_init (struct block_request *, bool write,
+                         block_sector_t, size_t cnt, void *buffer,
+                         block_done_func *, void *aux);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
+void block_set_queue_depth (struct block *, int depth);
+int block_queue_depth (const struct block *);
+
+/* I/O schedulers. */
+bool block_set_scheduler (const char *name);
+
 /* Statistics. */
+unsigned long long block_read_cnt (const struct block *);
+unsigned long long block_write_cnt (const struct block *);
+void block_get_stats (struct block *, struct blockstat *);
 void block_print_stats (void);
+
+/* Tracing. */
+void block_trace_init (size_t cnt, bool to_scratch);
+void block_trace_dump (void);
 
-/* Lower-level interface to block device drivers. */
+/* Lower-level interface to block device drivers.
+
+   READ_MULTIPLE and WRITE_MULTIPLE transfer CNT consecutive
+   sectors in as few device commands as the driver can manage.
+   They are optional: if a driver leaves them null, multi-sector
+   requests are broken into single-sector calls.
+
+   TRANSFER_SG, also optional, transfers consecutive sectors to
+   or from SEG_CNT separate buffers in one command.  If present,
+   merged requests are passed to it directly instead of going
+   through a bounce buffer.
+
+   A driver that can have several commands in flight at once
+   may call block_set_queue_depth(), so that its operations are
+   called from that many threads concurrently.
+
+   A driver whose devices share a controller reports the cycles
+   its operations spend waiting for the controller with
+   block_add_lock_wait(). */
+
+/* A buffer taking part in a scatter/gather transfer. */
+struct block_segment
+  {
+    void *buffer;               /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    size_t cnt;                 /* Number of sectors. */
+  };
 
 struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+    void (*read_multiple) (void *aux, block_sector_t, size_t cnt,
+                           void *buffer);
+    void (*write_multiple) (void *aux, block_sector_t, size_t cnt,
+                            const void *buffer);
+    void (*transfer_sg) (void *aux, bool write, block_sector_t,
+                         const struct block_segment *, size_t seg_cnt);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void *block_get_aux (struct block *, const struct block_operations *);
+void block_add_lock_wait (struct block *, uint64_t cycles);
 
 #endif /* devices/block.h */
@@ -5,10 +5,13 @@
 #include <stdio.h>
 #include "devices/block.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -34,6 +37,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +53,51 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+#define CMD_READ_SECTOR_EXT 0x24        /* READ SECTOR EXT. */
+#define CMD_WRITE_SECTOR_EXT 0x34       /* WRITE SECTOR EXT. */
+#define CMD_READ_MULTIPLE_EXT 0x29      /* READ MULTIPLE EXT. */
+#define CMD_WRITE_MULTIPLE_EXT 0x39     /* WRITE MULTIPLE EXT. */
+#define CMD_READ_DMA_EXT 0x25           /* READ DMA EXT. */
+#define CMD_WRITE_DMA_EXT 0x35          /* WRITE DMA EXT. */
+
+/* Sectors addressable by the original 28-bit LBA commands.  The
+   EXT commands take a 48-bit LBA, which we use only for sectors
+   beyond this, since they need twice as many register writes. */
+#define LBA28_SECTORS (1UL << 28)
+
+/* Bus master IDE register offsets from a channel's bmi_base. */
+#define BMI_COMMAND 0           /* Command. */
+#define BMI_STATUS 2            /* Status. */
+#define BMI_PRDT 4              /* Physical address of PRD table. */
+
+/* Bus master Command Register bits. */
+#define BMI_CMD_START 0x01      /* Start transfer. */
+#define BMI_CMD_READ 0x08       /* Transfer from disk to memory. */
+
+/* Bus master Status Register bits.  Writing 1 clears them. */
+#define BMI_STA_ERROR 0x02      /* Transfer failed. */
+#define BMI_STA_IRQ 0x04        /* Device raised its interrupt. */
+
+/* A physical region descriptor, which tells the bus master where
+   one piece of a DMA transfer goes in memory.  A region may not
+   cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Size in bytes, with 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last descriptor. */
+  };
+
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Most sectors a single READ or WRITE command can transfer: a
+   sector count register of 0 means 256 sectors, or 128 kB. */
+#define MAX_COMMAND_SECTORS 256
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +106,11 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    int multiple_cnt;           /* Sectors per interrupt in READ/WRITE
+                                   MULTIPLE, or 0 if not supported. */
+    bool dma;                   /* Transfer data by bus master DMA? */
+    bool lba48;                 /* Supports 48-bit LBA (EXT commands)? */
+    struct block *block;        /* Block device, once registered. */
   };
 
 /* An ATA channel (aka controller).
@@ -72,6 +126,9 @@ struct channel
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    uint16_t bmi_base;          /* Bus master registers, 0 if no DMA. */
+    struct prd *prdt;           /* Page for PRD table, if bmi_base != 0. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -79,21 +136,31 @@ struct channel
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* If false (the default), disks of 1 GB or more are ignored. */
+bool ide_allow_large;
+
 static struct block_operations ide_operations;
 
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static uint16_t find_bus_master (void);
+static void set_multiple_mode (struct ata_disk *, int max_cnt);
+static void dma_transfer (struct ata_disk *, bool write, block_sector_t,
+                          size_t cnt, void *);
+static bool select_sector (struct ata_disk *, block_sector_t, size_t cnt);
+static uint8_t transfer_command (const struct ata_disk *, bool write,
+                                 bool dma, bool ext);
 static void issue_pio_command (struct channel *, uint8_t command);
-static void input_sector (struct channel *, void *);
-static void output_sector (struct channel *, const void *);
+static void input_sectors (struct channel *, void *, size_t cnt);
+static void output_sectors (struct channel *, const void *, size_t cnt);
 
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
 static void select_device (const struct ata_disk *);
 static void select_device_wait (const struct ata_disk *);
+static void acquire_channel (struct ata_disk *);
 
 static void interrupt_handler (struct intr_frame *);
 
@@ -101,6 +168,7 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bmi_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -126,6 +194,16 @@ ide_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+
+      /* Each channel has its own 8 bus master registers. */
+      c->bmi_base = 0;
+      c->prdt = NULL;
+      if (bmi_base != 0)
+        {
+          c->prdt = palloc_get_page (0);
+          if (c->prdt != NULL)
+            c->bmi_base = bmi_base + chan_no * 8;
+        }
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +214,10 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->multiple_cnt = 0;
+          d->dma = false;
+          d->lba48 = false;
+          d->block = NULL;
         }
 
       /* Register interrupt handler. */
@@ -155,6 +237,43 @@ ide_init (void)
     }
 }
 
+/* Looks for a PCI IDE controller capable of bus master DMA and
+   enables bus mastering on it.  Returns the I/O port base of its
+   bus master registers, or 0 if there is no such controller, in
+   which case all transfers use PIO. */
+static uint16_t
+find_bus_master (void)
+{
+  struct pci_addr a;
+  uint32_t bar;
+
+  /* Class 1, subclass 1 is an IDE controller.  Bit 7 of its
+     programming interface byte says it can be a bus master. */
+  if (!pci_find_class (0x01, 0x01, &a)
+      || !(pci_read8 (&a, PCI_REG_CLASS + 1) & 0x80))
+    return 0;
+
+  /* BAR4 gives the bus master registers, in I/O space. */
+  bar = pci_read32 (&a, PCI_REG_BAR0 + 4 * 4);
+  if (!(bar & 1) || (bar & 0xfffc) == 0)
+    return 0;
+
+  pci_write16 (&a, PCI_REG_COMMAND, (pci_read16 (&a, PCI_REG_COMMAND)
+                                     | PCI_CMD_IO | PCI_CMD_MASTER));
+  return bar & 0xfffc;
+}
+
+/* Returns the number of the IDE channel that BLOCK, an IDE disk
+   or a partition of one, is attached to, or -1 if BLOCK is not on
+   an IDE disk. */
+int
+ide_channel (struct block *block)
+{
+  struct ata_disk *d = block_get_aux (partition_disk (block),
+                                      &ide_operations);
+  return d != NULL ? d->channel - channels : -1;
+}
+
 /* Disk detection and identification. */
 
 static char *descramble_ata_string (char *, int size);
@@ -261,7 +380,7 @@ identify_ata_device (struct ata_disk *d)
 {
   struct channel *c = d->channel;
   char id[BLOCK_SECTOR_SIZE];
-  block_sector_t capacity;
+  uint64_t capacity;
   char *model, *serial;
   char extra_info[128];
   struct block *block;
@@ -279,11 +398,16 @@ identify_ata_device (struct ata_disk *d)
       d->is_ata = false;
       return;
     }
-  input_sector (c, id);
+  input_sectors (c, id, 1);
 
-  /* Calculate capacity.
+  /* Calculate capacity.  Bit 10 of word 83 says whether the disk
+     supports 48-bit LBA, in which case words 100 to 103 hold its
+     full capacity and words 60 and 61 at most 2**28 - 1 sectors.
      Read model name and serial number. */
-  capacity = *(uint32_t *) &id[60 * 2];
+  d->lba48 = (id[83 * 2 + 1] & 0x04) != 0;
+  capacity = (d->lba48
+              ? *(uint64_t *) &id[100 * 2]
+              : *(uint32_t *) &id[60 * 2]);
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
   snprintf (extra_info, sizeof extra_info,
@@ -292,20 +416,39 @@ identify_ata_device (struct ata_disk *d)
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
      allow access to those, we're less likely to scribble on
-     someone's important data.  You can disable this check by
-     hand if you really want to do so. */
-  if (capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE)
+     someone's important data.  The -ide-large kernel option
+     disables this check. */
+  if (capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE && !ide_allow_large)
     {
       printf ("%s: ignoring ", d->name);
-      print_human_readable_size (capacity * 512);
+      print_human_readable_size (capacity * BLOCK_SECTOR_SIZE);
       printf ("disk for safety\n");
       d->is_ata = false;
       return;
     }
 
+  /* Sector numbers are only 32 bits, so we can use no more than
+     the first 2 TB of a bigger disk. */
+  if (capacity > (block_sector_t) -1)
+    {
+      printf ("%s: using only first ", d->name);
+      print_human_readable_size ((uint64_t) (block_sector_t) -1
+                                 * BLOCK_SECTOR_SIZE);
+      printf ("of disk\n");
+      capacity = (block_sector_t) -1;
+    }
+
+  /* Word 47 holds the most sectors the disk can move per
+     interrupt with READ/WRITE MULTIPLE. */
+  set_multiple_mode (d, (uint8_t) id[47 * 2]);
+
+  /* Bit 8 of word 49 says whether the disk supports DMA. */
+  d->dma = c->bmi_base != 0 && (id[49 * 2 + 1] & 0x01) != 0;
+
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
+  d->block = block;
   partition_scan (block);
 }
 
@@ -337,25 +480,193 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
+/* Tells disk D to transfer up to MAX_CNT sectors per interrupt
+   in READ/WRITE MULTIPLE commands, rounded down to a power of
+   two.  Leaves D's multiple_cnt at 0 if MAX_CNT is 0 or the disk
+   rejects the setting, in which case multi-sector transfers take
+   one interrupt per sector. */
+static void
+set_multiple_mode (struct ata_disk *d, int max_cnt)
+{
+  struct channel *c = d->channel;
+
+  while (max_cnt & (max_cnt - 1))
+    max_cnt &= max_cnt - 1;
+  if (max_cnt <= 1)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), max_cnt);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if (!(inb (reg_alt_status (c)) & STA_ERR))
+    d->multiple_cnt = max_cnt;
+}
+
+/* Reads the CNT sectors starting at SEC_NO from disk D into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Each command moves up to MAX_COMMAND_SECTORS sectors,
+   by DMA with a single interrupt if possible, or else by PIO
+   taking one interrupt per block of D's multiple_cnt sectors.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_read_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                   void *buffer)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  size_t per_irq = d->multiple_cnt > 0 ? d->multiple_cnt : 1;
+  bool dma = d->dma && is_kernel_vaddr (buffer);
+  uint8_t *p = buffer;
+
+  acquire_channel (d);
+  while (cnt > 0)
+    {
+      size_t n = cnt < MAX_COMMAND_SECTORS ? cnt : MAX_COMMAND_SECTORS;
+      size_t done, blk;
+      bool ext;
+
+      if (dma)
+        {
+          dma_transfer (d, false, sec_no, n, p);
+          p += n * BLOCK_SECTOR_SIZE;
+          sec_no += n;
+          cnt -= n;
+          continue;
+        }
+
+      ext = select_sector (d, sec_no, n);
+      issue_pio_command (c, transfer_command (d, false, false, ext));
+      for (done = 0; done < n; done += blk)
+        {
+          blk = n - done < per_irq ? n - done : per_irq;
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                   d->name, sec_no + done);
+          input_sectors (c, p, blk);
+          p += blk * BLOCK_SECTOR_SIZE;
+        }
+      sec_no += n;
+      cnt -= n;
+    }
+  lock_release (&c->lock);
+}
+
+/* Writes the CNT sectors starting at SEC_NO to disk D from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving all of the
+   data.  Each command moves up to MAX_COMMAND_SECTORS sectors,
+   by DMA with a single interrupt if possible, or else by PIO
+   taking one interrupt per block of D's multiple_cnt sectors.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                    const void *buffer)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  size_t per_irq = d->multiple_cnt > 0 ? d->multiple_cnt : 1;
+  bool dma = d->dma && is_kernel_vaddr (buffer);
+  const uint8_t *p = buffer;
+
+  acquire_channel (d);
+  while (cnt > 0)
+    {
+      size_t n = cnt < MAX_COMMAND_SECTORS ? cnt : MAX_COMMAND_SECTORS;
+      size_t done, blk;
+      bool ext;
+
+      if (dma)
+        {
+          dma_transfer (d, true, sec_no, n, (void *) p);
+          p += n * BLOCK_SECTOR_SIZE;
+          sec_no += n;
+          cnt -= n;
+          continue;
+        }
+
+      ext = select_sector (d, sec_no, n);
+      issue_pio_command (c, transfer_command (d, true, false, ext));
+      for (done = 0; done < n; done += blk)
+        {
+          blk = n - done < per_irq ? n - done : per_irq;
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                   d->name, sec_no + done);
+          output_sectors (c, p, blk);
+          p += blk * BLOCK_SECTOR_SIZE;
+          sema_down (&c->completion_wait);
+        }
+      sec_no += n;
+      cnt -= n;
+    }
   lock_release (&c->lock);
 }
 
+/* Transfers the CNT sectors starting at SEC_NO between disk D
+   and BUFFER by bus master DMA, reading if WRITE is false.  CNT
+   must be between 1 and MAX_COMMAND_SECTORS.  The CPU only sets
+   up the transfer and then sleeps until the single interrupt at
+   its end.  D's channel must be locked. */
+static void
+dma_transfer (struct ata_disk *d, bool write, block_sector_t sec_no,
+              size_t cnt, void *buffer)
+{
+  struct channel *c = d->channel;
+  uint8_t direction = write ? 0 : BMI_CMD_READ;
+  uint8_t *p = buffer;
+  size_t left = cnt * BLOCK_SECTOR_SIZE;
+  struct prd *prd = c->prdt;
+  uint8_t status;
+  bool ext;
+
+  /* Describe BUFFER, which is physically contiguous because it
+     is in kernel memory, breaking it at 64 kB boundaries. */
+  while (left > 0)
+    {
+      uint32_t addr = vtop (p);
+      size_t size = 0x10000 - (addr & 0xffff);
+      if (size > left)
+        size = left;
+      prd->addr = addr;
+      prd->size = size;
+      prd->flags = size == left ? PRD_EOT : 0;
+      prd++;
+      p += size;
+      left -= size;
+    }
+
+  outl (c->bmi_base + BMI_PRDT, vtop (c->prdt));
+  outb (c->bmi_base + BMI_COMMAND, direction);
+  outb (c->bmi_base + BMI_STATUS, BMI_STA_ERROR | BMI_STA_IRQ);
+
+  ext = select_sector (d, sec_no, cnt);
+  issue_pio_command (c, transfer_command (d, write, true, ext));
+  outb (c->bmi_base + BMI_COMMAND, direction | BMI_CMD_START);
+  sema_down (&c->completion_wait);
+  outb (c->bmi_base + BMI_COMMAND, direction);
+
+  status = inb (c->bmi_base + BMI_STATUS);
+  outb (c->bmi_base + BMI_STATUS, BMI_STA_ERROR | BMI_STA_IRQ);
+  if ((status & BMI_STA_ERROR) || (inb (reg_alt_status (c)) & STA_ERR))
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+           d->name, write ? "write" : "read", sec_no);
+}
+
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read (void *d_, block_sector_t sec_no, void *buffer)
+{
+  ide_read_multiple (d_, sec_no, 1, buffer);
+}
+
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
    BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
    acknowledged receiving the data.
@@ -364,41 +675,95 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
 static void
 ide_write (void *d_, block_sector_t sec_no, const void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  ide_write_multiple (d_, sec_no, 1, buffer);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple,
+    NULL
   };
-
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
-static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+   writes SEC_NO and the sector count CNT, which must be between
+   1 and MAX_COMMAND_SECTORS, to the disk's sector selection
+   registers.  (We use LBA mode.)  Returns true if the transfer
+   reaches beyond the first 2**28 sectors, so that the caller
+   must issue a 48-bit EXT command, false otherwise. */
+static bool
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
+  bool ext = sec_no + cnt > LBA28_SECTORS;
 
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (!ext || d->lba48);
+  ASSERT (cnt >= 1 && cnt <= MAX_COMMAND_SECTORS);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
-  outb (reg_lbal (c), sec_no);
-  outb (reg_lbam (c), sec_no >> 8);
-  outb (reg_lbah (c), (sec_no >> 16));
-  outb (reg_device (c),
-        DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
+  if (ext)
+    {
+      /* The EXT commands read each register as a FIFO of two
+         bytes, so write the high-order bytes first.  Bits 32:47
+         of the LBA are always 0 for us. */
+      outb (reg_nsect (c), cnt >> 8);
+      outb (reg_lbal (c), sec_no >> 24);
+      outb (reg_lbam (c), 0);
+      outb (reg_lbah (c), 0);
+      outb (reg_nsect (c), cnt);
+      outb (reg_lbal (c), sec_no);
+      outb (reg_lbam (c), sec_no >> 8);
+      outb (reg_lbah (c), sec_no >> 16);
+      outb (reg_device (c),
+            DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0));
+    }
+  else
+    {
+      outb (reg_nsect (c), cnt == MAX_COMMAND_SECTORS ? 0 : cnt);
+      outb (reg_lbal (c), sec_no);
+      outb (reg_lbam (c), sec_no >> 8);
+      outb (reg_lbah (c), (sec_no >> 16));
+      outb (reg_device (c),
+            DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0)
+            | (sec_no >> 24));
+    }
+  return ext;
+}
+
+/* Returns the command that transfers data to disk D, if WRITE
+   is true, or from it, by bus master DMA if DMA is true or
+   otherwise by PIO, using a 48-bit EXT command if EXT is
+   true. */
+static uint8_t
+transfer_command (const struct ata_disk *d, bool write, bool dma, bool ext)
+{
+  if (dma)
+    return (write
+            ? (ext ? CMD_WRITE_DMA_EXT : CMD_WRITE_DMA)
+            : (ext ? CMD_READ_DMA_EXT : CMD_READ_DMA));
+  else if (d->multiple_cnt > 0)
+    return (write
+            ? (ext ? CMD_WRITE_MULTIPLE_EXT : CMD_WRITE_MULTIPLE)
+            : (ext ? CMD_READ_MULTIPLE_EXT : CMD_READ_MULTIPLE));
+  else
+    return (write
+            ? (ext ? CMD_WRITE_SECTOR_EXT : CMD_WRITE_SECTOR_RETRY)
+            : (ext ? CMD_READ_SECTOR_EXT : CMD_READ_SECTOR_RETRY));
+}
+
+/* Acquires the lock on disk D's channel, which D shares with the
+   other disk on the channel, and reports the time spent waiting
+   for it to the block layer. */
+static void
+acquire_channel (struct ata_disk *d)
+{
+  uint64_t start = timer_cycles ();
+
+  lock_acquire (&d->channel->lock);
+  if (d->block != NULL)
+    block_add_lock_wait (d->block, timer_cycles () - start);
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
@@ -414,20 +779,21 @@ issue_pio_command (struct channel *c, uint8_t command)
   outb (reg_command (c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for BLOCK_SECTOR_SIZE bytes. */
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTORS, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
 static void
-input_sector (struct channel *c, void *sector) 
+input_sectors (struct channel *c, void *sectors, size_t cnt) 
 {
-  insw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
+  insw (reg_data (c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain BLOCK_SECTOR_SIZE bytes. */
+/* Writes SECTORS to channel C's data register in PIO mode.
+   SECTORS must contain CNT * BLOCK_SECTOR_SIZE bytes. */
 static void
-output_sector (struct channel *c, const void *sector) 
+output_sectors (struct channel *c, const void *sectors, size_t cnt) 
 {
-  outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
+  outsw (reg_data (c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
 }
 
 /* Low-level ATA primitives. */
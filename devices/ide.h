@@ -1,6 +1,14 @@
 #ifndef DEVICES_IDE_H
 #define DEVICES_IDE_H
 
+#include <stdbool.h>
+
+struct block;
+
+/* Use IDE disks of 1 GB or more?  Off by default for safety. */
+extern bool ide_allow_large;
+
 void ide_init (void);
+int ide_channel (struct block *);
 
 #endif /* devices/ide.h */
@@ -33,6 +33,15 @@ partition_scan (struct block *block)
     printf ("%s: Device contains no partitions\n", block_name (block));
 }
 
+/* Returns the block device that BLOCK is a partition of, or
+   BLOCK itself if it is not a partition. */
+struct block *
+partition_disk (struct block *block)
+{
+  struct partition *p = block_get_aux (block, &partition_operations);
+  return p != NULL ? p->block : block;
+}
+
 /* Reads the partition table in the given SECTOR of BLOCK and
    scans it for partitions of interest to Pintos.
 
@@ -181,7 +190,9 @@ found_partition (struct block *block, uint8_t part_type,
       snprintf (name, sizeof name, "%s%d", block_name (block), part_nr);
       snprintf (extra_info, sizeof extra_info, "%s (%02x)",
                 partition_type_name (part_type), part_type);
-      block_register (name, type, extra_info, size, &partition_operations, p);
+      block_set_queue_depth (block_register (name, type, extra_info, size,
+                                             &partition_operations, p),
+                             block_queue_depth (block));
     }
 }
 
@@ -317,8 +328,67 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
   block_write (p->block, p->start + sector, buffer);
 }
 
+/* Reads the CNT sectors starting at SECTOR from partition P
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+static void
+partition_read_multiple (void *p_, block_sector_t sector, size_t cnt,
+                         void *buffer)
+{
+  struct partition *p = p_;
+  block_read_multiple (p->block, p->start + sector, cnt, buffer);
+}
+
+/* Writes the CNT sectors starting at SECTOR to partition P from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block has acknowledged receiving the data. */
+static void
+partition_write_multiple (void *p_, block_sector_t sector, size_t cnt,
+                          const void *buffer)
+{
+  struct partition *p = p_;
+  block_write_multiple (p->block, p->start + sector, cnt, buffer);
+}
+
+/* Transfers the consecutive sectors starting at SECTOR in
+   partition P to or from the SEG_CNT buffers in SEGS, reading if
+   WRITE is false.  The pieces are queued to the underlying
+   device together, so that it can merge them again. */
+static void
+partition_transfer_sg (void *p_, bool write, block_sector_t sector,
+                       const struct block_segment *segs, size_t seg_cnt)
+{
+  struct partition *p = p_;
+  struct block_request *reqs = malloc (seg_cnt * sizeof *reqs);
+  size_t i;
+
+  for (i = 0; i < seg_cnt; sector += segs[i++].cnt)
+    if (reqs != NULL)
+      {
+        block_request_init (&reqs[i], write, p->start + sector, segs[i].cnt,
+                            segs[i].buffer, NULL, NULL);
+        block_submit (p->block, &reqs[i]);
+      }
+    else if (write)
+      block_write_multiple (p->block, p->start + sector, segs[i].cnt,
+                            segs[i].buffer);
+    else
+      block_read_multiple (p->block, p->start + sector, segs[i].cnt,
+                           segs[i].buffer);
+
+  if (reqs != NULL)
+    {
+      for (i = 0; i < seg_cnt; i++)
+        block_wait (&reqs[i]);
+      free (reqs);
+    }
+}
+
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    partition_read_multiple,
+    partition_write_multiple,
+    partition_transfer_sg
   };
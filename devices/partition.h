@@ -4,5 +4,6 @@
 struct block;
 
 void partition_scan (struct block *);
+struct block *partition_disk (struct block *);
 
 #endif /* devices/partition.h */
@@ -0,0 +1,148 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/io.h"
+
+/* This code accesses PCI configuration space through the
+   "configuration mechanism #1" ports found on every PC chipset
+   since the original PCI boards.  It does just enough for
+   drivers to find their devices and program them. */
+
+/* Configuration space access ports. */
+#define PCI_CONFIG_ADDR 0xcf8   /* Selects function and register. */
+#define PCI_CONFIG_DATA 0xcfc   /* Data for the selected register. */
+
+/* Selects register REG of the function at A, rounded down to a
+   multiple of 4, for the next access through PCI_CONFIG_DATA. */
+static void
+select_register (const struct pci_addr *a, uint8_t reg)
+{
+  outl (PCI_CONFIG_ADDR, (0x80000000u | (a->bus << 16) | (a->dev << 11)
+                          | (a->func << 8) | (reg & 0xfc)));
+}
+
+/* Returns the 32-bit configuration register REG of the function
+   at A.  REG must be a multiple of 4. */
+uint32_t
+pci_read32 (const struct pci_addr *a, uint8_t reg)
+{
+  select_register (a, reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Returns the 16-bit configuration register REG of the function
+   at A.  REG must be a multiple of 2. */
+uint16_t
+pci_read16 (const struct pci_addr *a, uint8_t reg)
+{
+  select_register (a, reg);
+  return inw (PCI_CONFIG_DATA + (reg & 2));
+}
+
+/* Returns the 8-bit configuration register REG of the function
+   at A. */
+uint8_t
+pci_read8 (const struct pci_addr *a, uint8_t reg)
+{
+  select_register (a, reg);
+  return inb (PCI_CONFIG_DATA + (reg & 3));
+}
+
+/* Sets the 32-bit configuration register REG of the function at
+   A to VALUE.  REG must be a multiple of 4. */
+void
+pci_write32 (const struct pci_addr *a, uint8_t reg, uint32_t value)
+{
+  select_register (a, reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Sets the 16-bit configuration register REG of the function at
+   A to VALUE.  REG must be a multiple of 2. */
+void
+pci_write16 (const struct pci_addr *a, uint8_t reg, uint16_t value)
+{
+  select_register (a, reg);
+  outw (PCI_CONFIG_DATA + (reg & 2), value);
+}
+
+/* Scans every PCI bus for the INDEX'th function, counting from
+   0, for which MATCH returns true when passed its location, its
+   vendor and device IDs, and AUX.  If one is found, stores its
+   location in *A and returns true; otherwise, returns false. */
+static bool
+find_function (bool (*match) (const struct pci_addr *, uint32_t id,
+                              const void *aux),
+               const void *aux, int index, struct pci_addr *a)
+{
+  int bus, dev, func;
+
+  for (bus = 0; bus < 256; bus++)
+    for (dev = 0; dev < 32; dev++)
+      for (func = 0; func < 8; func++)
+        {
+          uint32_t id;
+
+          a->bus = bus;
+          a->dev = dev;
+          a->func = func;
+          id = pci_read32 (a, PCI_REG_VENDOR);
+          if ((id & 0xffff) == 0xffff)
+            {
+              /* No function 0 means no device at all. */
+              if (func == 0)
+                break;
+              continue;
+            }
+
+          if (match (a, id, aux) && index-- == 0)
+            return true;
+
+          /* Only multi-function devices have functions past 0. */
+          if (func == 0 && !(pci_read8 (a, PCI_REG_HEADER) & 0x80))
+            break;
+        }
+  return false;
+}
+
+/* Returns true if the function at A has the class and subclass
+   codes in the two bytes that CLASS_ points to. */
+static bool
+match_class (const struct pci_addr *a, uint32_t id UNUSED,
+             const void *class_)
+{
+  const uint8_t *class = class_;
+  uint32_t class_reg = pci_read32 (a, PCI_REG_CLASS);
+  return ((class_reg >> 24) == class[0]
+          && ((class_reg >> 16) & 0xff) == class[1]);
+}
+
+/* Scans every PCI bus for the first function with the given
+   CLASS and SUBCLASS codes.  If one is found, stores its location
+   in *A and returns true; otherwise, returns false. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, struct pci_addr *a)
+{
+  uint8_t codes[2] = {class, subclass};
+  return find_function (match_class, codes, 0, a);
+}
+
+/* Returns true if the vendor and device IDs in ID are those that
+   ID_ points to. */
+static bool
+match_device (const struct pci_addr *a UNUSED, uint32_t id,
+              const void *id_)
+{
+  return id == *(const uint32_t *) id_;
+}
+
+/* Scans every PCI bus for the INDEX'th function, counting from
+   0, with the given VENDOR and DEVICE IDs.  If one is found,
+   stores its location in *A and returns true; otherwise, returns
+   false. */
+bool
+pci_find_device (uint16_t vendor, uint16_t device, int index,
+                 struct pci_addr *a)
+{
+  uint32_t id = ((uint32_t) device << 16) | vendor;
+  return find_function (match_device, &id, index, a);
+}
@@ -0,0 +1,39 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Location of a PCI function in configuration space. */
+struct pci_addr
+  {
+    uint8_t bus;                /* Bus number, 0...255. */
+    uint8_t dev;                /* Device number, 0...31. */
+    uint8_t func;               /* Function number, 0...7. */
+  };
+
+/* Offsets of standard configuration space registers. */
+#define PCI_REG_VENDOR 0x00     /* Vendor ID (16 bits). */
+#define PCI_REG_DEVICE 0x02     /* Device ID (16 bits). */
+#define PCI_REG_COMMAND 0x04    /* Command (16 bits). */
+#define PCI_REG_CLASS 0x08      /* Class, subclass, prog IF, revision. */
+#define PCI_REG_HEADER 0x0e     /* Header type (8 bits). */
+#define PCI_REG_BAR0 0x10       /* First of six base address registers. */
+#define PCI_REG_IRQ 0x3c        /* Interrupt line (8 bits). */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001       /* Respond to I/O space accesses. */
+#define PCI_CMD_MEMORY 0x0002   /* Respond to memory space accesses. */
+#define PCI_CMD_MASTER 0x0004   /* Allow bus mastering. */
+
+uint32_t pci_read32 (const struct pci_addr *, uint8_t reg);
+uint16_t pci_read16 (const struct pci_addr *, uint8_t reg);
+uint8_t pci_read8 (const struct pci_addr *, uint8_t reg);
+void pci_write32 (const struct pci_addr *, uint8_t reg, uint32_t);
+void pci_write16 (const struct pci_addr *, uint8_t reg, uint16_t);
+
+bool pci_find_class (uint8_t class, uint8_t subclass, struct pci_addr *);
+bool pci_find_device (uint16_t vendor, uint16_t device, int index,
+                      struct pci_addr *);
+
+#endif /* devices/pci.h */
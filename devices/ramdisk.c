@@ -0,0 +1,154 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A block device kept in memory, for measuring the file system
+   and virtual memory code without disk latency.  Its contents
+   start out zeroed and are lost at shutdown. */
+
+/* Sectors per page of RAM disk storage. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A RAM disk. */
+struct ramdisk
+  {
+    uint8_t **pages;            /* Storage, SECTORS_PER_PAGE per page. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+/* Number of RAM disks created so far, for naming them. */
+static int ramdisk_cnt;
+
+static struct block_operations ramdisk_operations;
+
+/* Creates a zeroed RAM disk of SIZE_KB kB, rounded up to a whole
+   number of pages, and registers it as block device "ram0" (or
+   "ram1", ...) so that it can be given any role by name.
+   Returns the new device.  Panics if memory runs out. */
+struct block *
+ramdisk_init (size_t size_kb)
+{
+  struct ramdisk *rd;
+  char name[16];
+  size_t i;
+
+  rd = malloc (sizeof *rd);
+  if (rd == NULL)
+    PANIC ("Failed to allocate memory for RAM disk");
+  rd->page_cnt = DIV_ROUND_UP (size_kb * 1024, PGSIZE);
+  rd->pages = malloc (rd->page_cnt * sizeof *rd->pages);
+  if (rd->pages == NULL)
+    PANIC ("Failed to allocate memory for RAM disk");
+  for (i = 0; i < rd->page_cnt; i++)
+    {
+      rd->pages[i] = palloc_get_page (PAL_ZERO);
+      if (rd->pages[i] == NULL)
+        PANIC ("Not enough memory for %zu kB RAM disk", size_kb);
+    }
+
+  snprintf (name, sizeof name, "ram%d", ramdisk_cnt++);
+  return block_register (name, BLOCK_RAW, "memory-backed",
+                         rd->page_cnt * SECTORS_PER_PAGE,
+                         &ramdisk_operations, rd);
+}
+
+/* Copies as much of SOURCE as fits into RAMDISK, a page at a
+   time, so that it starts out with SOURCE's contents.  Used to
+   preload a file system image from the scratch disk at boot. */
+void
+ramdisk_load (struct block *ramdisk, struct block *source)
+{
+  block_sector_t cnt = block_size (source);
+  block_sector_t sector;
+  void *page;
+
+  ASSERT (ramdisk != source);
+
+  if (cnt > block_size (ramdisk))
+    cnt = block_size (ramdisk);
+  page = palloc_get_page (0);
+  if (page == NULL)
+    PANIC ("Not enough memory to load RAM disk");
+  for (sector = 0; sector < cnt; sector += SECTORS_PER_PAGE)
+    {
+      size_t n = cnt - sector < SECTORS_PER_PAGE ? cnt - sector
+                 : SECTORS_PER_PAGE;
+      block_read_multiple (source, sector, n, page);
+      block_write_multiple (ramdisk, sector, n, page);
+    }
+  palloc_free_page (page);
+  printf ("%s: loaded %'"PRDSNu" sectors from %s\n",
+          block_name (ramdisk), cnt, block_name (source));
+}
+
+/* Copies the CNT sectors starting at SECTOR in RD_ to or from
+   BUFFER, reading if WRITE is false.  The block layer serializes
+   requests to each device, so no locking is needed. */
+static void
+ramdisk_transfer (struct ramdisk *rd, bool write, block_sector_t sector,
+                  size_t cnt, void *buffer)
+{
+  uint8_t *p = buffer;
+
+  while (cnt > 0)
+    {
+      size_t ofs = sector % SECTORS_PER_PAGE;
+      size_t n = SECTORS_PER_PAGE - ofs < cnt ? SECTORS_PER_PAGE - ofs : cnt;
+      uint8_t *data = rd->pages[sector / SECTORS_PER_PAGE]
+                      + ofs * BLOCK_SECTOR_SIZE;
+
+      if (write)
+        memcpy (data, p, n * BLOCK_SECTOR_SIZE);
+      else
+        memcpy (p, data, n * BLOCK_SECTOR_SIZE);
+      sector += n;
+      cnt -= n;
+      p += n * BLOCK_SECTOR_SIZE;
+    }
+}
+
+/* Reads the CNT sectors starting at SECTOR from RAM disk RD_
+   into BUFFER. */
+static void
+ramdisk_read_multiple (void *rd_, block_sector_t sector, size_t cnt,
+                       void *buffer)
+{
+  ramdisk_transfer (rd_, false, sector, cnt, buffer);
+}
+
+/* Writes the CNT sectors starting at SECTOR to RAM disk RD_ from
+   BUFFER. */
+static void
+ramdisk_write_multiple (void *rd_, block_sector_t sector, size_t cnt,
+                        const void *buffer)
+{
+  ramdisk_transfer (rd_, true, sector, cnt, (void *) buffer);
+}
+
+/* Reads sector SECTOR from RAM disk RD_ into BUFFER. */
+static void
+ramdisk_read (void *rd_, block_sector_t sector, void *buffer)
+{
+  ramdisk_transfer (rd_, false, sector, 1, buffer);
+}
+
+/* Writes sector SECTOR to RAM disk RD_ from BUFFER. */
+static void
+ramdisk_write (void *rd_, block_sector_t sector, const void *buffer)
+{
+  ramdisk_transfer (rd_, true, sector, 1, (void *) buffer);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    ramdisk_read_multiple,
+    ramdisk_write_multiple,
+    NULL
+  };
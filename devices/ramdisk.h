@@ -0,0 +1,10 @@
+#ifndef DEVICES_RAMDISK_H
+#define DEVICES_RAMDISK_H
+
+#include <stddef.h>
+#include "devices/block.h"
+
+struct block *ramdisk_init (size_t size_kb);
+void ramdisk_load (struct block *ramdisk, struct block *source);
+
+#endif /* devices/ramdisk.h */
@@ -92,6 +92,7 @@ shutdown_power_off (void)
 
 #ifdef FILESYS
   filesys_done ();
+  block_trace_dump ();
 #endif
 
   print_stats ();
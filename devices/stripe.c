@@ -0,0 +1,174 @@
+#include "devices/stripe.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+
+/* A RAID-0 array, which stripes its sectors across several
+   member block devices so that a large transfer keeps all of
+   them busy at once.  Sectors are laid out in stripes of
+   STRIPE_SIZE sectors, dealt out to the members in turn:
+   stripe 0 goes to member 0, stripe 1 to member 1, and so on. */
+
+/* Most member devices in an array.  QEMU provides four disks. */
+#define STRIPE_MAX_MEMBERS 4
+
+/* A striped block device. */
+struct stripe
+  {
+    struct block *members[STRIPE_MAX_MEMBERS];  /* Member devices. */
+    size_t member_cnt;                          /* Number of members. */
+    block_sector_t stripe_size;                 /* Sectors per stripe. */
+  };
+
+/* Number of arrays created so far, for naming them. */
+static int stripe_cnt;
+
+static struct block_operations stripe_operations;
+
+/* Creates a striped block device over the comma-separated list
+   of block device names in MEMBERS, e.g. "hdb,hdc,hdd", with
+   STRIPE_SIZE sectors per stripe, and registers it as "md0"
+   (or "md1", ...).  Its size is that of the smallest member,
+   rounded down to a whole number of stripes, times the number
+   of members.  Returns the new device.  Panics if a member does
+   not exist or the list is invalid. */
+struct block *
+stripe_init (const char *members, block_sector_t stripe_size)
+{
+  struct stripe *s;
+  char *names, *name, *save_ptr;
+  block_sector_t member_size = (block_sector_t) -1;
+  char dev_name[16], extra_info[64];
+  size_t i;
+
+  s = malloc (sizeof *s);
+  names = malloc (strlen (members) + 1);
+  if (s == NULL || names == NULL)
+    PANIC ("Failed to allocate memory for striped device");
+  if (stripe_size == 0)
+    PANIC ("Stripe size must be at least one sector");
+  strlcpy (names, members, strlen (members) + 1);
+
+  s->member_cnt = 0;
+  s->stripe_size = stripe_size;
+  for (name = strtok_r (names, ",", &save_ptr); name != NULL;
+       name = strtok_r (NULL, ",", &save_ptr))
+    {
+      struct block *block = block_get_by_name (name);
+      if (block == NULL)
+        PANIC ("No such block device \"%s\"", name);
+      if (s->member_cnt >= STRIPE_MAX_MEMBERS)
+        PANIC ("Too many devices to stripe (maximum %d)",
+               STRIPE_MAX_MEMBERS);
+      for (i = 0; i < s->member_cnt; i++)
+        if (s->members[i] == block)
+          PANIC ("Can't stripe \"%s\" with itself", name);
+      s->members[s->member_cnt++] = block;
+      if (block_size (block) < member_size)
+        member_size = block_size (block);
+    }
+  free (names);
+  if (s->member_cnt == 0)
+    PANIC ("No devices to stripe");
+
+  member_size -= member_size % stripe_size;
+  snprintf (dev_name, sizeof dev_name, "md%d", stripe_cnt++);
+  snprintf (extra_info, sizeof extra_info,
+            "%zu-way striped, %'"PRDSNu"-sector stripes",
+            s->member_cnt, stripe_size);
+  return block_register (dev_name, BLOCK_RAW, extra_info,
+                         member_size * s->member_cnt,
+                         &stripe_operations, s);
+}
+
+/* Carries out a transfer of CNT sectors starting at SECTOR in
+   array S, to or from BUFFER.  The transfer is split at stripe
+   boundaries and the pieces are queued to all the members at
+   once, so that they work in parallel; each member's queue
+   merges the pieces that are adjacent on that member.  Returns
+   once all of them have finished. */
+static void
+stripe_transfer (struct stripe *s, bool write, block_sector_t sector,
+                 size_t cnt, void *buffer)
+{
+  size_t piece_cnt = cnt / s->stripe_size + 2;
+  struct block_request *reqs = malloc (piece_cnt * sizeof *reqs);
+  uint8_t *p = buffer;
+  size_t i, n;
+
+  for (n = 0; cnt > 0; n++)
+    {
+      block_sector_t stripe = sector / s->stripe_size;
+      block_sector_t ofs = sector % s->stripe_size;
+      struct block *member = s->members[stripe % s->member_cnt];
+      block_sector_t member_sector = (stripe / s->member_cnt
+                                      * s->stripe_size + ofs);
+      size_t piece = s->stripe_size - ofs;
+
+      if (piece > cnt)
+        piece = cnt;
+      if (reqs != NULL)
+        {
+          ASSERT (n < piece_cnt);
+          block_request_init (&reqs[n], write, member_sector, piece, p,
+                              NULL, NULL);
+          block_submit (member, &reqs[n]);
+        }
+      else if (write)
+        block_write_multiple (member, member_sector, piece, p);
+      else
+        block_read_multiple (member, member_sector, piece, p);
+      sector += piece;
+      cnt -= piece;
+      p += piece * BLOCK_SECTOR_SIZE;
+    }
+
+  if (reqs != NULL)
+    {
+      for (i = 0; i < n; i++)
+        block_wait (&reqs[i]);
+      free (reqs);
+    }
+}
+
+/* Reads the CNT sectors starting at SECTOR from array S_ into
+   BUFFER. */
+static void
+stripe_read_multiple (void *s_, block_sector_t sector, size_t cnt,
+                      void *buffer)
+{
+  stripe_transfer (s_, false, sector, cnt, buffer);
+}
+
+/* Writes the CNT sectors starting at SECTOR to array S_ from
+   BUFFER. */
+static void
+stripe_write_multiple (void *s_, block_sector_t sector, size_t cnt,
+                       const void *buffer)
+{
+  stripe_transfer (s_, true, sector, cnt, (void *) buffer);
+}
+
+/* Reads sector SECTOR from array S_ into BUFFER. */
+static void
+stripe_read (void *s_, block_sector_t sector, void *buffer)
+{
+  stripe_transfer (s_, false, sector, 1, buffer);
+}
+
+/* Writes sector SECTOR to array S_ from BUFFER. */
+static void
+stripe_write (void *s_, block_sector_t sector, const void *buffer)
+{
+  stripe_transfer (s_, true, sector, 1, (void *) buffer);
+}
+
+static struct block_operations stripe_operations =
+  {
+    stripe_read,
+    stripe_write,
+    stripe_read_multiple,
+    stripe_write_multiple,
+    NULL
+  };
@@ -0,0 +1,11 @@
+#ifndef DEVICES_STRIPE_H
+#define DEVICES_STRIPE_H
+
+#include "devices/block.h"
+
+/* Default stripe size in sectors. */
+#define STRIPE_DEFAULT_SECTORS 16
+
+struct block *stripe_init (const char *members, block_sector_t stripe_size);
+
+#endif /* devices/stripe.h */
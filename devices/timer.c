@@ -24,6 +24,10 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Number of CPU cycles per timer tick.
+   Initialized by timer_calibrate(). */
+static uint64_t cycles_per_tick;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
@@ -44,6 +48,8 @@ void
 timer_calibrate (void) 
 {
   unsigned high_bit, test_bit;
+  uint64_t start_cycles;
+  int64_t start;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
@@ -64,6 +70,16 @@ timer_calibrate (void)
       loops_per_tick |= test_bit;
 
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+  /* Count the cycles in one whole tick. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  start_cycles = timer_cycles ();
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  cycles_per_tick = timer_cycles () - start_cycles;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -84,6 +100,24 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the processor's time-stamp counter, which counts CPU
+   cycles since reset.  See [IA32-v2b] "RDTSC". */
+uint64_t
+timer_cycles (void)
+{
+  uint64_t cycles;
+  asm volatile ("rdtsc" : "=A" (cycles));
+  return cycles;
+}
+
+/* Returns the number of CPU cycles in a timer tick, as measured
+   by timer_calibrate(). */
+uint64_t
+timer_cycles_per_tick (void)
+{
+  return cycles_per_tick;
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void
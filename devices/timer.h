@@ -13,6 +13,10 @@ void timer_calibrate (void);
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
 
+/* CPU cycle counter, for timing short intervals. */
+uint64_t timer_cycles (void);
+uint64_t timer_cycles_per_tick (void);
+
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
@@ -0,0 +1,421 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The code in this file is a driver for virtio block devices,
+   as provided by QEMU's "-drive if=virtio", using the legacy PCI
+   transport and a single split virtqueue.  See [Virtio].
+
+   Each request is a chain of descriptors: a header giving the
+   operation and sector, one descriptor per data segment, and a
+   status byte for the device to fill in.  Several requests may
+   be in flight at once; the device completes them in any order
+   and interrupts once for any number of completions. */
+
+/* PCI IDs of a legacy virtio block device. */
+#define VIRTIO_VENDOR 0x1af4
+#define VIRTIO_BLK_DEVICE 0x1001
+
+/* Legacy virtio registers, as offsets from the I/O base in BAR0. */
+#define REG_HOST_FEATURES 0x00  /* Features device offers (32 bits). */
+#define REG_GUEST_FEATURES 0x04 /* Features driver uses (32 bits). */
+#define REG_QUEUE_PFN 0x08      /* Page number of queue (32 bits). */
+#define REG_QUEUE_SIZE 0x0c     /* Entries in queue (16 bits). */
+#define REG_QUEUE_SELECT 0x0e   /* Selects a queue (16 bits). */
+#define REG_QUEUE_NOTIFY 0x10   /* Tells device a queue has work (16). */
+#define REG_STATUS 0x12         /* Device status (8 bits). */
+#define REG_ISR 0x13            /* Interrupt status, read clears (8). */
+#define REG_CAPACITY 0x14       /* Size in sectors (64 bits). */
+
+/* Device Status Register bits. */
+#define STATUS_ACKNOWLEDGE 0x01 /* Driver has noticed the device. */
+#define STATUS_DRIVER 0x02      /* Driver knows how to drive it. */
+#define STATUS_DRIVER_OK 0x04   /* Driver is ready. */
+
+/* Virtqueue descriptor flags. */
+#define DESC_NEXT 0x01          /* NEXT member is valid. */
+#define DESC_WRITE 0x02         /* Device writes, rather than reads. */
+
+/* Virtqueue layout.  The legacy transport puts the used ring on
+   the first page boundary after the available ring. */
+struct vring_desc
+  {
+    uint64_t addr;              /* Physical address of buffer. */
+    uint32_t len;               /* Length of buffer in bytes. */
+    uint16_t flags;             /* DESC_* flags. */
+    uint16_t next;              /* Next descriptor in chain. */
+  };
+
+struct vring_avail
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Next entry driver will fill. */
+    uint16_t ring[];            /* Heads of chains for the device. */
+  };
+
+struct vring_used_elem
+  {
+    uint32_t id;                /* Head of completed chain. */
+    uint32_t len;               /* Bytes written by device. */
+  };
+
+struct vring_used
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Next entry device will fill. */
+    struct vring_used_elem ring[];
+  };
+
+/* Block request header, read by the device. */
+struct request_header
+  {
+    uint32_t type;              /* REQ_IN or REQ_OUT. */
+    uint32_t reserved;
+    uint64_t sector;            /* First sector. */
+  };
+
+#define REQ_IN 0                /* Read from device. */
+#define REQ_OUT 1               /* Write to device. */
+#define REQ_STATUS_OK 0         /* Request succeeded. */
+
+/* Requests each device may have in flight at once. */
+#define QUEUE_DEPTH 4
+
+/* A request in flight, indexed by the head of its chain. */
+struct slot
+  {
+    struct request_header header;       /* Read by device. */
+    uint8_t status;                     /* Written by device. */
+    struct semaphore done;              /* Up'd on completion. */
+  };
+
+/* A virtio block device. */
+struct virtio_blk
+  {
+    char name[8];               /* Name, e.g. "vda". */
+    uint16_t io_base;           /* Base I/O port. */
+    uint8_t irq;                /* Interrupt in use. */
+    uint16_t queue_size;        /* Number of descriptors. */
+    struct vring_desc *desc;    /* Descriptor table. */
+    struct vring_avail *avail;  /* Available ring. */
+    volatile struct vring_used *used;   /* Used ring. */
+    uint16_t last_used;         /* Used entries handled by interrupt. */
+    struct slot *slots;         /* Requests in flight. */
+
+    struct lock lock;           /* Protects the members below. */
+    struct condition desc_freed;        /* Signaled as chains free. */
+    uint16_t free_head;         /* First free descriptor. */
+    uint16_t free_cnt;          /* Number of free descriptors. */
+  };
+
+/* The devices found, at most one per letter "vda"..."vdd". */
+#define DEVICE_CNT 4
+static struct virtio_blk *devices[DEVICE_CNT];
+static size_t device_cnt;
+
+static struct block_operations virtio_blk_operations;
+
+static void probe_device (const struct pci_addr *);
+static void interrupt_handler (struct intr_frame *);
+
+/* Finds virtio block devices on the PCI bus and registers them
+   as block devices "vda", "vdb", and so on, along with their
+   partitions. */
+void
+virtio_blk_init (void)
+{
+  struct pci_addr a;
+  int i;
+
+  for (i = 0; (device_cnt < DEVICE_CNT
+               && pci_find_device (VIRTIO_VENDOR, VIRTIO_BLK_DEVICE, i, &a));
+       i++)
+    probe_device (&a);
+}
+
+/* Sets up the virtio block device at A and registers it. */
+static void
+probe_device (const struct pci_addr *a)
+{
+  struct virtio_blk *d;
+  uint32_t bar = pci_read32 (a, PCI_REG_BAR0);
+  size_t avail_ofs, used_ofs, page_cnt;
+  uint64_t capacity;
+  struct block *block;
+  uint8_t *queue;
+  size_t i;
+
+  /* The legacy interface is in I/O space. */
+  if (!(bar & 1))
+    return;
+  pci_write16 (a, PCI_REG_COMMAND, (pci_read16 (a, PCI_REG_COMMAND)
+                                    | PCI_CMD_IO | PCI_CMD_MASTER));
+
+  d = malloc (sizeof *d);
+  if (d == NULL)
+    PANIC ("Failed to allocate memory for virtio device");
+  snprintf (d->name, sizeof d->name, "vd%c", 'a' + (int) device_cnt);
+  d->io_base = bar & 0xfffc;
+  d->irq = pci_read8 (a, PCI_REG_IRQ) + 0x20;
+  lock_init (&d->lock);
+  cond_init (&d->desc_freed);
+
+  /* Reset the device, say hello, and accept no optional
+     features. */
+  outb (d->io_base + REG_STATUS, 0);
+  outb (d->io_base + REG_STATUS, STATUS_ACKNOWLEDGE);
+  outb (d->io_base + REG_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+  outl (d->io_base + REG_GUEST_FEATURES, 0);
+
+  /* Set up queue 0. */
+  outw (d->io_base + REG_QUEUE_SELECT, 0);
+  d->queue_size = inw (d->io_base + REG_QUEUE_SIZE);
+  if (d->queue_size < 3)
+    {
+      printf ("%s: unusable queue size %"PRIu16"\n", d->name, d->queue_size);
+      free (d);
+      return;
+    }
+  avail_ofs = d->queue_size * sizeof *d->desc;
+  used_ofs = ROUND_UP (avail_ofs + sizeof *d->avail
+                       + (d->queue_size + 1) * sizeof *d->avail->ring,
+                       PGSIZE);
+  page_cnt = DIV_ROUND_UP (used_ofs + sizeof *d->used
+                           + d->queue_size * sizeof *d->used->ring
+                           + sizeof (uint16_t), PGSIZE);
+  queue = palloc_get_multiple (PAL_ZERO, page_cnt);
+  d->slots = malloc (d->queue_size * sizeof *d->slots);
+  if (queue == NULL || d->slots == NULL)
+    PANIC ("%s: failed to allocate memory for virtqueue", d->name);
+  d->desc = (struct vring_desc *) queue;
+  d->avail = (struct vring_avail *) (queue + avail_ofs);
+  d->used = (struct vring_used *) (queue + used_ofs);
+  d->last_used = 0;
+  for (i = 0; i < d->queue_size; i++)
+    d->desc[i].next = i + 1;
+  d->free_head = 0;
+  d->free_cnt = d->queue_size;
+  outl (d->io_base + REG_QUEUE_PFN, vtop (queue) >> PGBITS);
+
+  /* Devices may share an interrupt line, so one handler serves
+     all of them. */
+  for (i = 0; i < device_cnt; i++)
+    if (devices[i]->irq == d->irq)
+      break;
+  if (i == device_cnt)
+    intr_register_ext (d->irq, interrupt_handler, "virtio-blk");
+  devices[device_cnt++] = d;
+
+  outb (d->io_base + REG_STATUS,
+        STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_DRIVER_OK);
+
+  /* Register. */
+  capacity = (inl (d->io_base + REG_CAPACITY)
+              | (uint64_t) inl (d->io_base + REG_CAPACITY + 4) << 32);
+  if (capacity > (block_sector_t) -1)
+    capacity = (block_sector_t) -1;
+  block = block_register (d->name, BLOCK_RAW, "virtio", capacity,
+                          &virtio_blk_operations, d);
+  block_set_queue_depth (block, QUEUE_DEPTH);
+  partition_scan (block);
+}
+
+/* Takes a descriptor off D's free list and returns its index.
+   D's lock must be held, and a descriptor must be free. */
+static uint16_t
+alloc_desc (struct virtio_blk *d)
+{
+  uint16_t idx = d->free_head;
+
+  ASSERT (d->free_cnt > 0);
+  d->free_head = d->desc[idx].next;
+  d->free_cnt--;
+  return idx;
+}
+
+/* Appends descriptor IDX, covering SIZE bytes at BUFFER, to the
+   chain whose last descriptor is *PREV, and makes it the new
+   last descriptor. */
+static void
+chain_desc (struct virtio_blk *d, uint16_t *prev, uint16_t idx,
+            void *buffer, size_t size, uint16_t flags)
+{
+  d->desc[idx].addr = vtop (buffer);
+  d->desc[idx].len = size;
+  d->desc[idx].flags = flags;
+  if (*prev != idx)
+    {
+      d->desc[*prev].flags |= DESC_NEXT;
+      d->desc[*prev].next = idx;
+    }
+  *prev = idx;
+}
+
+/* Carries out one request on device D, moving the consecutive
+   sectors starting at SECTOR to or from the SEG_CNT buffers in
+   SEGS, which must be in kernel memory.  Waits for the request
+   to finish, while other threads may issue requests of their
+   own. */
+static void
+do_request (struct virtio_blk *d, bool write, block_sector_t sector,
+            const struct block_segment *segs, size_t seg_cnt)
+{
+  struct slot *slot;
+  uint16_t head, prev, idx;
+  uint8_t status;
+  size_t i;
+
+  lock_acquire (&d->lock);
+  while (d->free_cnt < seg_cnt + 2)
+    cond_wait (&d->desc_freed, &d->lock);
+
+  /* Build the chain: header, data, status. */
+  head = prev = alloc_desc (d);
+  slot = &d->slots[head];
+  slot->header.type = write ? REQ_OUT : REQ_IN;
+  slot->header.reserved = 0;
+  slot->header.sector = sector;
+  slot->status = 0xff;
+  sema_init (&slot->done, 0);
+  chain_desc (d, &prev, head, &slot->header, sizeof slot->header, 0);
+  for (i = 0; i < seg_cnt; i++)
+    {
+      ASSERT (is_kernel_vaddr (segs[i].buffer));
+      chain_desc (d, &prev, alloc_desc (d), segs[i].buffer,
+                  segs[i].cnt * BLOCK_SECTOR_SIZE, write ? 0 : DESC_WRITE);
+    }
+  chain_desc (d, &prev, alloc_desc (d), &slot->status, sizeof slot->status,
+              DESC_WRITE);
+
+  /* Offer it to the device. */
+  d->avail->ring[d->avail->idx % d->queue_size] = head;
+  barrier ();
+  d->avail->idx++;
+  barrier ();
+  outw (d->io_base + REG_QUEUE_NOTIFY, 0);
+  lock_release (&d->lock);
+
+  sema_down (&slot->done);
+
+  /* Free the chain. */
+  lock_acquire (&d->lock);
+  status = slot->status;
+  for (idx = head; ; )
+    {
+      uint16_t flags = d->desc[idx].flags;
+      uint16_t next = d->desc[idx].next;
+      d->desc[idx].next = d->free_head;
+      d->free_head = idx;
+      d->free_cnt++;
+      if (!(flags & DESC_NEXT))
+        break;
+      idx = next;
+    }
+  cond_broadcast (&d->desc_freed, &d->lock);
+  lock_release (&d->lock);
+
+  if (status != REQ_STATUS_OK)
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+           d->name, write ? "write" : "read", sector);
+}
+
+/* Transfers the consecutive sectors starting at SECTOR on device
+   D_ to or from the SEG_CNT buffers in SEGS, reading if WRITE is
+   false, in as few requests as the queue size allows. */
+static void
+virtio_blk_transfer_sg (void *d_, bool write, block_sector_t sector,
+                        const struct block_segment *segs, size_t seg_cnt)
+{
+  struct virtio_blk *d = d_;
+  size_t max_segs = d->queue_size - 2;
+
+  while (seg_cnt > 0)
+    {
+      size_t n = seg_cnt < max_segs ? seg_cnt : max_segs;
+      size_t i;
+
+      do_request (d, write, sector, segs, n);
+      for (i = 0; i < n; i++)
+        sector += segs[i].cnt;
+      segs += n;
+      seg_cnt -= n;
+    }
+}
+
+/* Reads the CNT sectors starting at SECTOR from device D_ into
+   BUFFER. */
+static void
+virtio_blk_read_multiple (void *d_, block_sector_t sector, size_t cnt,
+                          void *buffer)
+{
+  struct block_segment seg = {buffer, cnt};
+  virtio_blk_transfer_sg (d_, false, sector, &seg, 1);
+}
+
+/* Writes the CNT sectors starting at SECTOR to device D_ from
+   BUFFER. */
+static void
+virtio_blk_write_multiple (void *d_, block_sector_t sector, size_t cnt,
+                           const void *buffer)
+{
+  struct block_segment seg = {(void *) buffer, cnt};
+  virtio_blk_transfer_sg (d_, true, sector, &seg, 1);
+}
+
+/* Reads sector SECTOR from device D_ into BUFFER. */
+static void
+virtio_blk_read (void *d_, block_sector_t sector, void *buffer)
+{
+  virtio_blk_read_multiple (d_, sector, 1, buffer);
+}
+
+/* Writes sector SECTOR to device D_ from BUFFER. */
+static void
+virtio_blk_write (void *d_, block_sector_t sector, const void *buffer)
+{
+  virtio_blk_write_multiple (d_, sector, 1, buffer);
+}
+
+static struct block_operations virtio_blk_operations =
+  {
+    virtio_blk_read,
+    virtio_blk_write,
+    virtio_blk_read_multiple,
+    virtio_blk_write_multiple,
+    virtio_blk_transfer_sg
+  };
+
+/* Virtio interrupt handler.  Wakes up the threads waiting for
+   every request the device has completed since the last
+   interrupt. */
+static void
+interrupt_handler (struct intr_frame *f)
+{
+  size_t i;
+
+  for (i = 0; i < device_cnt; i++)
+    {
+      struct virtio_blk *d = devices[i];
+
+      /* Reading the ISR acknowledges the interrupt. */
+      if (d->irq != f->vec_no || !(inb (d->io_base + REG_ISR) & 1))
+        continue;
+      while (d->last_used != d->used->idx)
+        {
+          uint32_t id = d->used->ring[d->last_used % d->queue_size].id;
+          sema_up (&d->slots[id].done);
+          d->last_used++;
+        }
+    }
+}
@@ -24,8 +24,9 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
-  /* Create and open output file. */
-  if (!create (argv[2], filesize (in_fd))) 
+  /* Create and open output file.  It starts out empty, because
+     copying extends it without having to zero it first. */
+  if (!create (argv[2], 0)) 
     {
       printf ("%s: create failed\n", argv[2]);
       return EXIT_FAILURE;
@@ -37,14 +38,16 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
-  /* Copy data. */
+  /* Copy data inside the kernel. */
   for (;;) 
     {
-      char buffer[1024];
-      int bytes_read = read (in_fd, buffer, sizeof buffer);
-      if (bytes_read == 0)
+      int left = filesize (in_fd) - tell (in_fd);
+      int bytes_copied;
+
+      if (left <= 0)
         break;
-      if (write (out_fd, buffer, bytes_read) != bytes_read) 
+      bytes_copied = copy_file_range (in_fd, out_fd, left);
+      if (bytes_copied <= 0) 
         {
           printf ("%s: write failed\n", argv[2]);
           return EXIT_FAILURE;
@@ -0,0 +1,57 @@
+/* iostat.c
+
+   Prints statistics for each block device that has been used:
+   bytes and requests in each direction, how many transfers were
+   sequential, time spent waiting for a shared controller, and
+   histograms of service time, queueing time, and queue depth.
+   Times are in CPU cycles, grouped by power of 2.  This won't
+   work until project 4. */
+
+#include <syscall.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+static void
+print_histogram (const char *label, const uint64_t *hist, int cnt)
+{
+  int i;
+
+  printf ("  %s:", label);
+  for (i = 0; i < cnt; i++)
+    if (hist[i] != 0)
+      printf (" %d=%"PRIu64, i, hist[i]);
+  printf ("\n");
+}
+
+int
+main (void)
+{
+  struct blockstat st;
+  int i;
+
+  for (i = 0; blockstat (i, &st); i++)
+    {
+      uint64_t lock_wait_ms;
+
+      if (st.transfers == 0)
+        continue;
+
+      /* The timer ticks 100 times per second. */
+      lock_wait_ms = (st.cycles_per_tick == 0 ? 0
+                      : st.lock_wait / st.cycles_per_tick * 10);
+      printf ("%s (%s): %"PRIu64" reads (%"PRIu64" bytes), "
+              "%"PRIu64" writes (%"PRIu64" bytes)\n",
+              st.name, st.role, st.reads, st.read_bytes,
+              st.writes, st.write_bytes);
+      printf ("  %"PRIu64" transfers, %"PRIu64"%% sequential, "
+              "%"PRIu64" ms waiting for controller\n",
+              st.transfers, st.sequential * 100 / st.transfers,
+              lock_wait_ms);
+      print_histogram ("service time (log2 cycles)", st.service,
+                       BLOCKSTAT_BUCKETS);
+      print_histogram ("queue time (log2 cycles)", st.queued,
+                       BLOCKSTAT_BUCKETS);
+      print_histogram ("queue depth", st.depth, BLOCKSTAT_DEPTHS);
+    }
+  return EXIT_SUCCESS;
+}
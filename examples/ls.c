@@ -24,38 +24,45 @@ list_dir (const char *dir, bool verbose)
 
   if (isdir (dir_fd))
     {
-      char name[READDIR_MAX_LEN];
+      char buffer[512];
+      int size;
 
       printf ("%s", dir);
       if (verbose)
         printf (" (inumber %d)", inumber (dir_fd));
       printf (":\n");
 
-      while (readdir (dir_fd, name)) 
+      while ((size = getdents (dir_fd, buffer, sizeof buffer)) > 0) 
         {
-          printf ("%s", name); 
-          if (verbose) 
-            {
-              char full_name[128];
-              int entry_fd;
+          int ofs;
 
-              snprintf (full_name, sizeof full_name, "%s/%s", dir, name);
-              entry_fd = open (full_name);
+          for (ofs = 0; ofs < size; )
+            {
+              struct dirent *d = (struct dirent *) (buffer + ofs);
 
-              printf (": ");
-              if (entry_fd != -1)
+              printf ("%s", d->d_name); 
+              if (verbose && d->d_type == DT_DIR)
+                printf (": directory, inumber %d", d->d_ino);
+              else if (verbose) 
                 {
-                  if (isdir (entry_fd))
-                    printf ("directory");
+                  char full_name[128];
+                  int entry_fd;
+
+                  snprintf (full_name, sizeof full_name, "%s/%s",
+                            dir, d->d_name);
+                  entry_fd = open (full_name);
+
+                  printf (": ");
+                  if (entry_fd != -1)
+                    printf ("%d-byte file, inumber %d",
+                            filesize (entry_fd), d->d_ino);
                   else
-                    printf ("%d-byte file", filesize (entry_fd));
-                  printf (", inumber %d", inumber (entry_fd));
+                    printf ("open failed");
+                  close (entry_fd);
                 }
-              else
-                printf ("open failed");
-              close (entry_fd);
+              printf ("\n");
+              ofs += d->d_reclen;
             }
-          printf ("\n");
         }
     }
   else 
@@ -1,9 +1,21 @@
 #include "filesys/cache.h"
+#include <stdlib.h>
+#include <string.h>
 #include "filesys/filesys.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 #include "threads/thread.h"
 #include "devices/timer.h"
 
+/* Maximum number of cache entries. */
+#define CACHE_CNT 64
+
+static unsigned long long hit_cnt;   /* Lookups found in the cache. */
+static unsigned long long miss_cnt;  /* Lookups not found in the cache. */
+
+static struct cache_entry* lookup_cache (block_sector_t, bool dirty,
+                                         const void *data);
+
 void cache_init (void)
 {
   list_init(&cache_list);
@@ -26,10 +38,14 @@ struct cache_entry* get_cache (block_sector_t sector)
   return NULL;
 }
 
-struct cache_entry* add_cache (block_sector_t sector, bool dirty)
+/* Brings SECTOR into the cache, evicting another entry if the
+   cache is full, and returns its entry with open_cnt incremented.
+   Fills the entry from the journal or the disk if READ is true;
+   otherwise leaves it for the caller to overwrite completely. */
+struct cache_entry* add_cache (block_sector_t sector, bool dirty, bool read)
 {
   struct cache_entry *c;
-  if (cache_size < 64)
+  if (cache_size < CACHE_CNT)
   {
     cache_size++;
     c = malloc(sizeof(struct cache_entry));
@@ -50,7 +66,9 @@ struct cache_entry* add_cache (block_sector_t sector, bool dirty)
 
   c->open_cnt++;
   c->sector = sector;
-  block_read(fs_device, c->sector, &c->block);
+  c->owner = CACHE_NO_OWNER;
+  if (read && !journal_read (c->sector, &c->block))
+    block_read(fs_device, c->sector, &c->block);
   c->dirty = dirty;
   c->accessed = true;
   return c;
@@ -69,7 +87,9 @@ struct cache_entry* evict_cache(void) {
       c->accessed = false;
     else
     {
-      if (c->dirty)
+      /* A sector the journal holds is dropped without writing;
+         the journal supplies it again on the next miss. */
+      if (c->dirty && !journal_holds (c->sector))
         block_write(fs_device, c->sector, &c->block);
       return c;
     }
@@ -78,53 +98,336 @@ struct cache_entry* evict_cache(void) {
 }
 
 struct cache_entry* check_cache (block_sector_t sector, bool dirty)
+{
+  return lookup_cache(sector, dirty, NULL);
+}
+
+/* Returns the cache entry for SECTOR with open_cnt incremented,
+   adding one if it is not cached.  If DATA is non-null, the
+   entry's contents are replaced by DATA before CACHELOCK is
+   released, so that no one finds a reused entry still holding
+   another sector's bytes; otherwise a new entry is filled from
+   disk. */
+static struct cache_entry* lookup_cache (block_sector_t sector, bool dirty,
+                                         const void *data)
 {
   lock_acquire(&CACHELOCK);  
   struct cache_entry *c = get_cache(sector);
 
   if(c) {
+    hit_cnt++;
     c->open_cnt++;
     c->dirty |= dirty;
     c->accessed = true;
   }
   else {
-    c = add_cache(sector, dirty);
+    miss_cnt++;
+    c = add_cache(sector, dirty, data == NULL);
     if (!c)
       PANIC("Not enough memory for buffer cache.");
   }
+  if (data)
+    memcpy(&c->block, data, BLOCK_SECTOR_SIZE);
   lock_release(&CACHELOCK);
   return c;
 }
 
+/* Stores the number of cache hits and misses so far into *HITS
+   and *MISSES. */
+void cache_get_stats (unsigned long long *hits, unsigned long long *misses)
+{
+  lock_acquire(&CACHELOCK);
+  *hits = hit_cnt;
+  *misses = miss_cnt;
+  lock_release(&CACHELOCK);
+}
+
+/* Drops sector SECTOR from the cache, without writing it back,
+   because its contents on disk are about to be replaced directly.
+   The sector must not be in use. */
+void cache_invalidate (block_sector_t sector)
+{
+  lock_acquire(&CACHELOCK);
+  struct cache_entry *c = get_cache(sector);
+  if (c)
+  {
+    ASSERT (c->open_cnt == 0);
+    list_remove(&c->elem);
+    free(c);
+    cache_size--;
+  }
+  lock_release(&CACHELOCK);
+}
+
+/* Copies sector SECTOR into BUFFER through the cache. */
+void cache_read (block_sector_t sector, void *buffer)
+{
+  struct cache_entry *c = check_cache(sector, false);
+  memcpy(buffer, &c->block, BLOCK_SECTOR_SIZE);
+  c->open_cnt--;
+}
+
+/* Replaces the contents of sector SECTOR with BUFFER in the
+   cache, without reading the old contents from disk.  The sector
+   reaches the disk when it is written back.  OWNER is the inode
+   sector of the file the data belongs to, or CACHE_NO_OWNER. */
+void cache_write (block_sector_t sector, const void *buffer,
+                  block_sector_t owner)
+{
+  struct cache_entry *c = lookup_cache(sector, true, buffer);
+  c->dirty = true;
+  c->owner = owner;
+  c->open_cnt--;
+}
+
+/* Maximum number of sectors cache_read_direct() and
+   cache_write_direct() take care of at a time, one bit of a
+   uint32_t each. */
+#define DIRECT_BATCH 32
+
+/* Copies sector SECTOR into BUFFER from the cache or, failing
+   that, the journal, since either may be newer than the disk.
+   Returns false if neither has it.  CACHELOCK must be held. */
+static bool copy_newer (block_sector_t sector, void *buffer)
+{
+  struct cache_entry *c = get_cache(sector);
+  if (c)
+  {
+    memcpy(buffer, &c->block, BLOCK_SECTOR_SIZE);
+    return true;
+  }
+  return journal_read (sector, buffer);
+}
+
+/* Reads the CNT <= DIRECT_BATCH sectors starting at SECTOR into
+   BUFFER, as cache_read_direct(). */
+static void read_direct_batch (block_sector_t sector, size_t cnt,
+                               uint8_t *buffer)
+{
+  uint32_t uncached = 0;
+  size_t i, end;
+
+  lock_acquire(&CACHELOCK);
+  for (i = 0; i < cnt; i++)
+    if (!copy_newer(sector + i, buffer + i * BLOCK_SECTOR_SIZE))
+      uncached |= 1u << i;
+  lock_release(&CACHELOCK);
+  if (uncached == 0)
+    return;
+
+  for (i = 0; i < cnt; i = end)
+  {
+    bool is_uncached = (uncached >> i) & 1;
+    for (end = i + 1; end < cnt && ((uncached >> end) & 1) == is_uncached;
+         end++)
+      continue;
+    if (is_uncached)
+      block_read_multiple(fs_device, sector + i, end - i,
+                          buffer + i * BLOCK_SECTOR_SIZE);
+  }
+
+  /* A sector written into the cache while the disk was being read
+     is newer than what was read. */
+  lock_acquire(&CACHELOCK);
+  for (i = 0; i < cnt; i++)
+    if ((uncached >> i) & 1)
+      copy_newer(sector + i, buffer + i * BLOCK_SECTOR_SIZE);
+  lock_release(&CACHELOCK);
+}
+
+/* Copies the CNT sectors starting at SECTOR into BUFFER without
+   bringing them into the cache.  Sectors that are cached, or
+   that the journal holds, may be newer than the disk, so they
+   are copied from there; each run of the rest is read from disk
+   with a single multi-sector request, without holding CACHELOCK,
+   so that a long transfer does not hold up the rest of the
+   cache. */
+void cache_read_direct (block_sector_t sector, size_t cnt, void *buffer)
+{
+  uint8_t *p = buffer;
+
+  while (cnt > 0)
+  {
+    size_t batch = cnt < DIRECT_BATCH ? cnt : DIRECT_BATCH;
+    read_direct_batch(sector, batch, p);
+    sector += batch;
+    p += batch * BLOCK_SECTOR_SIZE;
+    cnt -= batch;
+  }
+}
+
+/* Writes the CNT <= DIRECT_BATCH sectors in BUFFER to disk,
+   starting at SECTOR, as cache_write_direct(). */
+static void write_direct_batch (block_sector_t sector, size_t cnt,
+                                const uint8_t *buffer)
+{
+  uint32_t cached = 0;
+  size_t i;
+
+  /* Cached copies stay dirty until the disk has caught up, in case
+     they are evicted in the meantime. */
+  lock_acquire(&CACHELOCK);
+  for (i = 0; i < cnt; i++)
+  {
+    struct cache_entry *c = get_cache(sector + i);
+    if (c)
+    {
+      memcpy(&c->block, buffer + i * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE);
+      c->dirty = true;
+      cached |= 1u << i;
+    }
+  }
+  lock_release(&CACHELOCK);
+
+  block_write_multiple(fs_device, sector, cnt, buffer);
+
+  lock_acquire(&CACHELOCK);
+  for (i = 0; i < cnt; i++)
+  {
+    const uint8_t *p = buffer + i * BLOCK_SECTOR_SIZE;
+    struct cache_entry *c = get_cache(sector + i);
+    if (c == NULL)
+      continue;
+    if (!((cached >> i) & 1) && !c->dirty)
+    {
+      /* Read from disk during the write, so possibly stale. */
+      memcpy(&c->block, p, BLOCK_SECTOR_SIZE);
+      c->dirty = true;
+    }
+    else if (c->open_cnt == 0 && !memcmp(&c->block, p, BLOCK_SECTOR_SIZE))
+      c->dirty = false;
+  }
+  lock_release(&CACHELOCK);
+}
+
+/* Writes the CNT sectors in BUFFER straight to disk, starting at
+   SECTOR, without bringing them into the cache.  Copies that are
+   already cached are updated to match, so that the cache never
+   holds stale data; those that are not in use and still match
+   once the write is done are marked clean, since the disk is now
+   up to date.  The sectors go to disk in multi-sector requests
+   issued without holding CACHELOCK. */
+void cache_write_direct (block_sector_t sector, size_t cnt,
+                         const void *buffer)
+{
+  const uint8_t *p = buffer;
+
+  while (cnt > 0)
+  {
+    size_t batch = cnt < DIRECT_BATCH ? cnt : DIRECT_BATCH;
+    write_direct_batch(sector, batch, p);
+    sector += batch;
+    p += batch * BLOCK_SECTOR_SIZE;
+    cnt -= batch;
+  }
+}
+
+/* Writes the CNT entries in ENTRIES to disk.  All of them are
+   queued at once, so that the I/O scheduler can order them and
+   merge adjacent sectors, and then waited for. */
+static void write_entries (struct cache_entry **entries, size_t cnt)
+{
+  struct block_request *reqs = malloc(cnt * sizeof *reqs);
+  size_t i;
+
+  if (reqs == NULL)
+  {
+    for (i = 0; i < cnt; i++)
+      block_write(fs_device, entries[i]->sector, &entries[i]->block);
+    return;
+  }
+  for (i = 0; i < cnt; i++)
+  {
+    block_request_init(&reqs[i], true, entries[i]->sector, 1,
+                       &entries[i]->block, NULL, NULL);
+    block_submit(fs_device, &reqs[i]);
+  }
+  for (i = 0; i < cnt; i++)
+    block_wait(&reqs[i]);
+  free(reqs);
+}
+
+/* Writes every dirty entry to disk, except entries in use and
+   sectors the journal holds, which are written later.  If CLEAR
+   is true, also empties the cache. */
 void cache_write_all (bool clear)
 {
+  struct cache_entry *dirty[CACHE_CNT];
+  size_t dirty_cnt = 0;
+  size_t i;
+
   lock_acquire(&CACHELOCK);  
   struct list_elem *next, *e;
-  for(e= list_begin(&cache_list); e != list_end(&cache_list);)
+  for(e= list_begin(&cache_list); e != list_end(&cache_list);
+      e = list_next(e))
+  {
+    struct cache_entry *c = list_entry(e, struct cache_entry, elem);
+    if (c->dirty && c->open_cnt == 0 && !journal_holds (c->sector))
+      dirty[dirty_cnt++] = c;
+  }
+  write_entries(dirty, dirty_cnt);
+  for (i = 0; i < dirty_cnt; i++)
+    dirty[i]->dirty = false;
+  for(e= list_begin(&cache_list); clear && e != list_end(&cache_list);)
   {
     next = list_next(e);
     struct cache_entry *c = list_entry(e, struct cache_entry, elem);
-    if (c->dirty)
-    {
-      block_write (fs_device, c->sector, &c->block);
-      c->dirty = false;
-    }
-    if (clear)
-    {
-      list_remove(&c->elem);
-      free(c);
-    }
+    list_remove(&c->elem);
+    free(c);
     e = next;
   }
-  lock_acquire(&CACHELOCK);  
+  if (clear)
+    cache_size = 0;
+  lock_release(&CACHELOCK);  
+}
+
+/* Orders cache entries by ascending sector number. */
+static int compare_sectors (const void *a_, const void *b_)
+{
+  const struct cache_entry *a = *(struct cache_entry * const *) a_;
+  const struct cache_entry *b = *(struct cache_entry * const *) b_;
+  return a->sector < b->sector ? -1 : a->sector > b->sector;
+}
+
+/* Writes back the dirty entries holding data of the file whose
+   inode is in sector OWNER, in ascending sector order, without
+   touching anything else in the cache.  Entries in use are written
+   too, since they hold the file's completed writes, but stay dirty
+   in case a write to them is still in progress. */
+void cache_sync (block_sector_t owner)
+{
+  struct cache_entry *dirty[CACHE_CNT];
+  size_t dirty_cnt = 0;
+  struct list_elem *e;
+  size_t i;
+
+  lock_acquire(&CACHELOCK);
+  for (e = list_begin(&cache_list); e != list_end(&cache_list);
+       e = list_next(e))
+  {
+    struct cache_entry *c = list_entry(e, struct cache_entry, elem);
+    if (c->dirty && c->owner == owner && !journal_holds (c->sector))
+      dirty[dirty_cnt++] = c;
+  }
+  qsort(dirty, dirty_cnt, sizeof *dirty, compare_sectors);
+  write_entries(dirty, dirty_cnt);
+  for (i = 0; i < dirty_cnt; i++)
+    if (dirty[i]->open_cnt == 0)
+      dirty[i]->dirty = false;
+  lock_release(&CACHELOCK);
 }
 
+/* Every few seconds, commits the journal's running transaction,
+   writes dirty sectors back, and checkpoints the journal if its
+   log is filling up. */
 void thread_func_write_back(void *aux UNUSED)
 {
   while(true)
   {
     timer_sleep(5*TIMER_FREQ);
+    journal_commit();
     cache_write_all(false);
+    journal_checkpoint(false);
   }
 }
 
@@ -9,9 +9,13 @@ struct list cache_list;
 uint32_t cache_size;
 struct lock CACHELOCK;
 
+/* Owner of a cache entry that does not hold file data. */
+#define CACHE_NO_OWNER ((block_sector_t) -1)
+
 struct cache_entry {
   uint8_t block[BLOCK_SECTOR_SIZE];
   block_sector_t sector;
+  block_sector_t owner;   /* Inode sector of the file whose data this is. */
   bool dirty;
   bool accessed;
   int open_cnt;
@@ -20,10 +24,17 @@ struct cache_entry {
 
 void cache_init (void);
 struct cache_entry* get_cache (block_sector_t);
-struct cache_entry* add_cache (block_sector_t, bool);
+struct cache_entry* add_cache (block_sector_t, bool dirty, bool read);
 struct cache_entry* evict_cache (void);
 struct cache_entry* check_cache (block_sector_t, bool);
+void cache_invalidate (block_sector_t);
+void cache_read (block_sector_t, void *);
+void cache_write (block_sector_t, const void *, block_sector_t owner);
+void cache_read_direct (block_sector_t, size_t cnt, void *);
+void cache_write_direct (block_sector_t, size_t cnt, const void *);
 void cache_write_all (bool);
+void cache_sync (block_sector_t owner);
+void cache_get_stats (unsigned long long *hits, unsigned long long *misses);
 void thread_func_write_back (void *aux);
 void thread_create_read_ahead (block_sector_t sector);
 void thread_func_read_ahead (void *aux);
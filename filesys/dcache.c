@@ -0,0 +1,194 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* The directory entry cache remembers the result of looking up
+   a name in a directory, keyed by the directory's inode sector
+   and the name, so that walking a path does not have to scan
+   the directory's entries on every call.  Names that were not
+   found are remembered too, as negative entries. */
+
+/* Maximum number of cached entries. */
+#define DCACHE_SIZE 128
+
+/* A cached directory entry. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* Element in dentries. */
+    struct list_elem lru_elem;          /* Element in lru_list. */
+    block_sector_t parent;              /* Sector of directory's inode. */
+    block_sector_t sector;              /* Entry's inode or DCACHE_NEGATIVE. */
+    uint8_t type;                       /* Entry's type, one of DT_*. */
+    const char *name;                   /* Entry name. */
+  };
+
+static struct hash dentries;    /* All cached entries. */
+static struct list lru_list;    /* Same entries, most recently used first. */
+static struct lock dcache_lock; /* Protects dentries and lru_list. */
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+static struct dentry *dentry_find (block_sector_t, const char *);
+static void dentry_delete (struct dentry *);
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void)
+{
+  hash_init (&dentries, dentry_hash, dentry_less, NULL);
+  list_init (&lru_list);
+  lock_init (&dcache_lock);
+}
+
+/* Looks up NAME in the directory whose inode is in sector
+   PARENT.  Returns false if the cache knows nothing about NAME.
+   Otherwise returns true and sets *SECTORP to the sector of
+   NAME's inode, or to DCACHE_NEGATIVE if NAME is known not to
+   exist, and *TYPEP to the type recorded in NAME's directory
+   entry. */
+bool
+dcache_lookup (block_sector_t parent, const char *name,
+               block_sector_t *sectorp, uint8_t *typep)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = dentry_find (parent, name);
+  if (d != NULL)
+    {
+      list_remove (&d->lru_elem);
+      list_push_front (&lru_list, &d->lru_elem);
+      *sectorp = d->sector;
+      *typep = d->type;
+    }
+  lock_release (&dcache_lock);
+
+  return d != NULL;
+}
+
+/* Records that NAME in the directory whose inode is in sector
+   PARENT refers to the inode in SECTOR, whose directory entry
+   has the given TYPE, or that it does not exist if SECTOR is
+   DCACHE_NEGATIVE.  Replaces any entry already cached for NAME.
+   Caching is best effort, so running out of memory is not an
+   error. */
+void
+dcache_insert (block_sector_t parent, const char *name,
+               block_sector_t sector, uint8_t type)
+{
+  size_t name_len = strlen (name);
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = dentry_find (parent, name);
+  if (d != NULL)
+    {
+      d->sector = sector;
+      d->type = type;
+      list_remove (&d->lru_elem);
+      list_push_front (&lru_list, &d->lru_elem);
+      lock_release (&dcache_lock);
+      return;
+    }
+
+  if (hash_size (&dentries) >= DCACHE_SIZE)
+    dentry_delete (list_entry (list_back (&lru_list),
+                               struct dentry, lru_elem));
+
+  d = malloc (sizeof *d + name_len + 1);
+  if (d != NULL)
+    {
+      char *copy = (char *) (d + 1);
+      memcpy (copy, name, name_len + 1);
+      d->parent = parent;
+      d->sector = sector;
+      d->type = type;
+      d->name = copy;
+      hash_insert (&dentries, &d->hash_elem);
+      list_push_front (&lru_list, &d->lru_elem);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Forgets anything cached about NAME in the directory whose
+   inode is in sector PARENT. */
+void
+dcache_invalidate (block_sector_t parent, const char *name)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = dentry_find (parent, name);
+  if (d != NULL)
+    dentry_delete (d);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets every entry cached for the directory whose inode is
+   in sector PARENT.  Must be called when that directory is
+   removed, because its sector may later be reused. */
+void
+dcache_purge_dir (block_sector_t parent)
+{
+  struct list_elem *e, *next;
+
+  lock_acquire (&dcache_lock);
+  for (e = list_begin (&lru_list); e != list_end (&lru_list); e = next)
+    {
+      struct dentry *d = list_entry (e, struct dentry, lru_elem);
+      next = list_next (e);
+      if (d->parent == parent)
+        dentry_delete (d);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Returns the cached entry for NAME in PARENT, or a null pointer
+   if there is none.  The caller must hold dcache_lock. */
+static struct dentry *
+dentry_find (block_sector_t parent, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  key.parent = parent;
+  key.name = name;
+  e = hash_find (&dentries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Removes D from the cache and frees it.
+   The caller must hold dcache_lock. */
+static void
+dentry_delete (struct dentry *d)
+{
+  hash_delete (&dentries, &d->hash_elem);
+  list_remove (&d->lru_elem);
+  free (d);
+}
+
+/* Returns a hash value for the dentry containing E. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+/* Returns true if the dentry containing A precedes the one
+   containing B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+
+  if (a->parent != b->parent)
+    return a->parent < b->parent;
+  return strcmp (a->name, b->name) < 0;
+}
@@ -0,0 +1,19 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Sector value stored in a negative entry, that is, a cached
+   record that a name does not exist in a directory. */
+#define DCACHE_NEGATIVE ((block_sector_t) -1)
+
+void dcache_init (void);
+bool dcache_lookup (block_sector_t parent, const char *name,
+                    block_sector_t *sectorp, uint8_t *typep);
+void dcache_insert (block_sector_t parent, const char *name,
+                    block_sector_t sector, uint8_t type);
+void dcache_invalidate (block_sector_t parent, const char *name);
+void dcache_purge_dir (block_sector_t parent);
+
+#endif /* filesys/dcache.h */
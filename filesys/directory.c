@@ -1,12 +1,21 @@
 #include "filesys/directory.h"
+#include <dirent.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
 
+/* Directory locks are inode locks.  A thread that holds more
+   than one takes them in this order, so that no two threads can
+   deadlock: a directory's lock before that of any directory
+   beneath it, as dir_remove() does, and the locks of two
+   directories neither of which is beneath the other in
+   ascending order of inode sector, as dir_lock_pair() does. */
+
 /* A directory. */
 struct dir 
   {
@@ -14,14 +23,27 @@ struct dir
     off_t pos;                          /* Current position. */
   };
 
-/* A single directory entry. */
+/* A single directory entry.
+   TYPE occupies what used to be padding at the end of the
+   entry, so the entry size is unchanged.  Entries written before
+   it existed hold whatever happened to be on the stack there, so
+   read it through entry_type(). */
 struct dir_entry 
   {
     block_sector_t inode_sector;        /* Sector number of header. */
     char name[NAME_MAX + 1];            /* Null terminated file name. */
     bool in_use;                        /* In use or free? */
+    uint8_t type;                       /* DT_REG, DT_DIR, or DT_UNKNOWN. */
   };
 
+/* Returns the type recorded in E, or DT_UNKNOWN if E predates
+   types and holds a stray byte instead. */
+static uint8_t
+entry_type (const struct dir_entry *e)
+{
+  return e->type == DT_REG || e->type == DT_DIR ? e->type : DT_UNKNOWN;
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -112,6 +134,47 @@ lookup (const struct dir *dir, const char *name,
   return false;
 }
 
+/* Searches DIR for a file with the given NAME and returns true
+   if one exists, false otherwise.  On success, sets *SECTORP to
+   the sector of the file's inode and *TYPEP to the type recorded
+   in its directory entry (DT_UNKNOWN for entries written before
+   types were recorded), without opening the file's inode.
+   Consults the directory entry cache before scanning DIR, and
+   caches what the scan finds, including a miss. */
+bool
+dir_lookup_entry (const struct dir *dir, const char *name,
+                  block_sector_t *sectorp, uint8_t *typep)
+{
+  block_sector_t parent;
+  struct dir_entry e;
+
+  ASSERT (dir != NULL);
+  ASSERT (name != NULL);
+
+  parent = inode_get_inumber (dir->inode);
+  if (!dcache_lookup (parent, name, sectorp, typep))
+    {
+      /* Hold DIR's lock until the result is cached, so that a
+         concurrent dir_add() or dir_remove() cannot slip in
+         between the scan and the insertion. */
+      inode_lock (dir->inode);
+      if (lookup (dir, name, &e, NULL))
+        {
+          *sectorp = e.inode_sector;
+          *typep = entry_type (&e);
+        }
+      else
+        {
+          *sectorp = DCACHE_NEGATIVE;
+          *typep = DT_UNKNOWN;
+        }
+      dcache_insert (parent, name, *sectorp, *typep);
+      inode_unlock (dir->inode);
+    }
+
+  return *sectorp != DCACHE_NEGATIVE;
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
@@ -120,13 +183,11 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
-  struct dir_entry e;
+  block_sector_t sector;
+  uint8_t type;
 
-  ASSERT (dir != NULL);
-  ASSERT (name != NULL);
-
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  if (dir_lookup_entry (dir, name, &sector, &type))
+    *inode = inode_open (sector);
   else
     *inode = NULL;
 
@@ -135,12 +196,13 @@ dir_lookup (const struct dir *dir, const char *name,
 
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
-   INODE_SECTOR.
+   INODE_SECTOR, and it is a directory if ISDIR is true.
    Returns true if successful, false on failure.
-   Fails if NAME is invalid (i.e. too long) or a disk or memory
-   error occurs. */
+   Fails if NAME is invalid (i.e. too long), if DIR has been
+   removed, or if a disk or memory error occurs. */
 bool
-dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
+dir_add (struct dir *dir, const char *name, block_sector_t inode_sector,
+         bool isdir)
 {
   struct dir_entry e;
   off_t ofs;
@@ -153,8 +215,10 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  inode_lock (dir->inode);
+
+  /* Check that DIR still exists and that NAME is not in use. */
+  if (inode_is_removed (dir->inode) || lookup (dir, name, NULL, NULL))
     goto done;
 
   if (!inode_add_parent(inode_get_inumber(dir_get_inode(dir)),
@@ -177,9 +241,14 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
+  e.type = isdir ? DT_DIR : DT_REG;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (success)
+    dcache_insert (inode_get_inumber (dir->inode), name, inode_sector,
+                   e.type);
 
  done:
+  inode_unlock (dir->inode);
   return success;
 }
 
@@ -191,39 +260,84 @@ dir_remove (struct dir *dir, const char *name)
 {
   struct dir_entry e;
   struct inode *inode = NULL;
+  bool is_dir = false;
   bool success = false;
   off_t ofs;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  inode_lock (dir->inode);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
   
   /* Open inode. */
-  inode = inode_is_open (e.inode_sector);
-  if (inode == NULL) 
-    inode = inode_open(e.inode_sector);
-  
-  if (inode == dir_get_inode(thread_current()->cwd))
-    goto done;
-  if (inode_is_dir(inode) && (!dir_is_empty(inode) || inode_get_open_cnt(inode)>1))
+  inode = inode_open (e.inode_sector);
+  if (inode == NULL || inode == dir_get_inode(thread_current()->cwd))
     goto done;
+
+  /* A directory is locked, after its parent, while it is checked
+     for emptiness and marked removed, so that nothing can be
+     added to it in between. */
+  is_dir = inode_is_dir (inode);
+  if (is_dir)
+    {
+      inode_lock (inode);
+      if (!dir_is_empty(inode) || inode_get_open_cnt(inode)>1)
+        goto done;
+    }
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+  if (is_dir)
+    dcache_purge_dir (e.inode_sector);
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  if (is_dir)
+    inode_unlock (inode);
+  inode_unlock (dir->inode);
   inode_close (inode);
   return success;
 }
 
+/* Acquires the locks of directories A and B, which may be the
+   same directory, for an operation such as a rename that
+   changes both.  Neither may be an ancestor of the other.  The
+   locks are always taken in order of inode sector, so two
+   threads locking the same pair cannot deadlock. */
+void
+dir_lock_pair (struct dir *a, struct dir *b)
+{
+  struct inode *first = a->inode, *second = b->inode;
+
+  if (inode_get_inumber (first) > inode_get_inumber (second))
+    {
+      first = b->inode;
+      second = a->inode;
+    }
+  inode_lock (first);
+  if (second != first)
+    inode_lock (second);
+}
+
+/* Releases the locks acquired by dir_lock_pair(A, B). */
+void
+dir_unlock_pair (struct dir *a, struct dir *b)
+{
+  if (b->inode != a->inode)
+    inode_unlock (b->inode);
+  inode_unlock (a->inode);
+}
+
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
    contains no more entries. */
@@ -231,19 +345,93 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
+  inode_lock (dir->inode);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
+          break;
         } 
     }
-  return false;
+  inode_unlock (dir->inode);
+  return found;
+}
+
+/* Number of directory entries read from disk at a time by
+   dir_getdents(). */
+#define GETDENTS_BATCH 8
+
+/* Reads entries from DIR, starting at its current position, and
+   packs them into BUFFER as `struct dirent' records until the
+   next one would not fit in SIZE bytes or DIR has no more
+   entries.  Advances DIR's position past the entries returned.
+   Returns the number of bytes stored, which is 0 at the end of
+   the directory, or -1 if BUFFER is too small to hold even the
+   next entry. */
+off_t
+dir_getdents (struct dir *dir, void *buffer, size_t size)
+{
+  struct dir_entry *batch;
+  size_t used = 0;
+  bool full = false;
+
+  batch = malloc (GETDENTS_BATCH * sizeof *batch);
+  if (batch == NULL)
+    return -1;
+
+  inode_lock (dir->inode);
+  while (!full)
+    {
+      off_t bytes = inode_read_at (dir->inode, batch,
+                                   GETDENTS_BATCH * sizeof *batch, dir->pos);
+      size_t cnt = bytes / sizeof *batch;
+      size_t i;
+
+      if (cnt == 0)
+        break;
+      for (i = 0; i < cnt; i++)
+        {
+          struct dir_entry *e = &batch[i];
+          if (e->in_use)
+            {
+              size_t name_len = strlen (e->name);
+              size_t reclen = DIRENT_RECLEN (name_len);
+              struct dirent *d = (struct dirent *) ((uint8_t *) buffer + used);
+
+              if (used + reclen > size)
+                {
+                  full = true;
+                  break;
+                }
+              d->d_ino = e->inode_sector;
+              d->d_reclen = reclen;
+              d->d_type = entry_type (e);
+              if (d->d_type == DT_UNKNOWN)
+                {
+                  struct inode *inode = inode_open (e->inode_sector);
+                  if (inode != NULL)
+                    d->d_type = inode_is_dir (inode) ? DT_DIR : DT_REG;
+                  inode_close (inode);
+                }
+              memcpy (d->d_name, e->name, name_len + 1);
+              used += reclen;
+            }
+          dir->pos += sizeof *e;
+        }
+    }
+  inode_unlock (dir->inode);
+  free (batch);
+
+  return used == 0 && full ? -1 : (off_t) used;
 }
 
+/* Returns true if the directory in INODE has no entries in use.
+   The caller must hold INODE's lock. */
 bool 
 dir_is_empty (struct inode *inode)
 {
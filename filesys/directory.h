@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "devices/block.h"
+#include "filesys/off_t.h"
 
 /* Maximum length of a file name component.
    This is the traditional UNIX maximum length.
@@ -23,9 +24,14 @@ struct inode *dir_get_inode (struct dir *);
 
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
-bool dir_add (struct dir *, const char *name, block_sector_t);
+bool dir_lookup_entry (const struct dir *, const char *name,
+                       block_sector_t *, uint8_t *type);
+bool dir_add (struct dir *, const char *name, block_sector_t, bool isdir);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+void dir_lock_pair (struct dir *, struct dir *);
+void dir_unlock_pair (struct dir *, struct dir *);
+off_t dir_getdents (struct dir *, void *buffer, size_t size);
 
 bool dir_is_empty (struct inode*);
 bool dir_is_root (struct dir*);
@@ -9,6 +9,7 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    bool direct;                /* Bypass the buffer cache? */
   };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +24,7 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->direct = false;
       return file;
     }
   else
@@ -68,7 +70,7 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read = file_read_at (file, buffer, size, file->pos);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -81,6 +83,8 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
+  if (file->direct)
+    return inode_read_direct (file->inode, buffer, size, file_ofs);
   return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
@@ -94,7 +98,7 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written = file_write_at (file, buffer, size, file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
@@ -110,9 +114,135 @@ off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
+  if (file->direct)
+    return inode_write_direct (file->inode, buffer, size, file_ofs);
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads from FILE into the IOV_CNT buffers in IOV, filling each
+   in turn, starting at the file's current position.
+   Returns the number of bytes actually read,
+   which may be less than requested if end of file is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, size_t iov_cnt)
+{
+  off_t bytes_read = 0;
+
+  if (!file->direct)
+    bytes_read = inode_read_iov (file->inode, iov, iov_cnt, file->pos);
+  else
+    for (; iov_cnt > 0; iov++, iov_cnt--)
+      {
+        off_t n = inode_read_direct (file->inode, iov->iov_base,
+                                     iov->iov_len, file->pos + bytes_read);
+        bytes_read += n;
+        if (n != (off_t) iov->iov_len)
+          break;
+      }
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/* Writes the contents of the IOV_CNT buffers in IOV into FILE,
+   one after another, starting at the file's current position.
+   Returns the number of bytes actually written,
+   which may be less than requested if the disk fills up.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, size_t iov_cnt)
+{
+  off_t bytes_written = 0;
+
+  if (!file->direct)
+    bytes_written = inode_write_iov (file->inode, iov, iov_cnt, file->pos);
+  else
+    for (; iov_cnt > 0; iov++, iov_cnt--)
+      {
+        off_t n = inode_write_direct (file->inode, iov->iov_base,
+                                      iov->iov_len,
+                                      file->pos + bytes_written);
+        bytes_written += n;
+        if (n != (off_t) iov->iov_len)
+          break;
+      }
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
+/* Copies up to SIZE bytes from SRC to DST, starting at each
+   file's current position, without passing through a caller's
+   buffer.  Returns the number of bytes actually copied, which may
+   be less than SIZE if end of SRC is reached, and advances both
+   files' positions by that much.  Returns -1 without copying
+   anything if SRC and DST are the same file and the ranges
+   overlap. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  off_t src_left = inode_length (src->inode) - src->pos;
+  off_t bytes_copied;
+
+  if (size > src_left)
+    size = src_left;
+  if (dst->inode == src->inode
+      && dst->pos < src->pos + size && src->pos < dst->pos + size)
+    return -1;
+  bytes_copied = inode_copy (dst->inode, dst->pos, src->inode, src->pos,
+                             size);
+  dst->pos += bytes_copied;
+  src->pos += bytes_copied;
+  return bytes_copied;
+}
+
+/* Writes FILE's data and, unless DATA_ONLY is true and no more
+   than the data has changed, its metadata to disk. */
+void
+file_sync (struct file *file, bool data_only)
+{
+  ASSERT (file != NULL);
+  inode_sync (file->inode, data_only);
+}
+
+/* Sets FILE's length to LENGTH bytes, extending it with zeros or
+   releasing the space past LENGTH.  FILE's position is not
+   changed.  Returns true if successful. */
+bool
+file_truncate (struct file *file, off_t length)
+{
+  ASSERT (file != NULL);
+  return inode_truncate (file->inode, length);
+}
+
+/* Reserves disk space for LEN bytes of FILE starting at OFFSET,
+   without changing FILE's length or contents.  Returns true if
+   successful. */
+bool
+file_allocate (struct file *file, off_t offset, off_t len)
+{
+  ASSERT (file != NULL);
+  return inode_allocate (file->inode, offset, len);
+}
+
+/* Stores FILE compressed from now on.  Data already written is
+   compressed as it is rewritten.  Returns true if successful. */
+bool
+file_compress (struct file *file)
+{
+  ASSERT (file != NULL);
+  return inode_set_compressed (file->inode);
+}
+
+/* Sets whether reads and writes through FILE bypass the buffer
+   cache.  Direct I/O suits large streaming transfers, whose data
+   would otherwise push everything else out of the cache. */
+void
+file_set_direct (struct file *file, bool direct)
+{
+  ASSERT (file != NULL);
+  file->direct = direct;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -1,6 +1,8 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
+#include <uio.h>
 #include "filesys/off_t.h"
 
 struct inode;
@@ -16,6 +18,20 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_readv (struct file *, const struct iovec *, size_t iov_cnt);
+off_t file_writev (struct file *, const struct iovec *, size_t iov_cnt);
+off_t file_copy (struct file *dst, struct file *src, off_t size);
+
+/* Making changes durable. */
+void file_sync (struct file *, bool data_only);
+
+/* Changing the space a file occupies. */
+bool file_truncate (struct file *, off_t length);
+bool file_allocate (struct file *, off_t offset, off_t len);
+bool file_compress (struct file *);
+
+/* Bypassing the buffer cache. */
+void file_set_direct (struct file *, bool);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
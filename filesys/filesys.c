@@ -1,5 +1,6 @@
 #include "filesys/filesys.h"
 #include <debug.h>
+#include <dirent.h>
 #include <stdio.h>
 #include <string.h>
 #include "filesys/file.h"
@@ -7,6 +8,9 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "filesys/cache.h"
+#include "filesys/dcache.h"
+#include "filesys/journal.h"
+#include "filesys/tmpfs.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
 
@@ -14,6 +18,12 @@
 struct block *fs_device;
 
 static void do_format (void);
+static bool create (const char *name, off_t initial_size, bool isdir,
+                    bool contiguous);
+static bool alloc_inode (struct dir *, block_sector_t *, off_t length,
+                         bool isdir, bool contiguous);
+static void free_inode (block_sector_t);
+static int get_next_part (char part[NAME_MAX + 1], const char **srcp);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -25,12 +35,15 @@ filesys_init (bool format)
     PANIC ("No file system device found, can't initialize file system.");
 
   inode_init ();
+  tmpfs_init ();
+  dcache_init ();
   cache_init ();
   free_map_init ();
 
   if (format) 
     do_format ();
 
+  journal_init ();
   free_map_open ();
 }
 
@@ -39,6 +52,8 @@ filesys_init (bool format)
   void
 filesys_done (void) 
 {
+  journal_commit ();
+  journal_checkpoint (true);
   cache_write_all(true);
   free_map_close ();
 }
@@ -49,24 +64,74 @@ filesys_done (void)
    or if internal memory allocation fails. */
 bool
 filesys_create (const char *name, off_t initial_size, bool isdir) 
+{
+  return create (name, initial_size, isdir, false);
+}
+
+/* Creates a regular file named NAME, INITIAL_SIZE bytes long,
+   for bulk loading.  Its data is laid out contiguously where
+   possible and is not zeroed, so the caller must overwrite all
+   of it.  Returns true if successful, false otherwise. */
+bool
+filesys_create_contiguous (const char *name, off_t initial_size)
+{
+  return create (name, initial_size, false, true);
+}
+
+/* Does the work of filesys_create() and
+   filesys_create_contiguous(). */
+static bool
+create (const char *name, off_t initial_size, bool isdir, bool contiguous)
 {
   block_sector_t inode_sector = 0;
-  struct dir *dir = get_dir(name, !isdir);
-  char *filename = get_filename(name);
+  char filename[NAME_MAX + 1];
+  struct dir *dir;
   bool success = false;
+
+  journal_begin ();
+  dir = get_dir(name, !isdir, filename);
   if (strcmp(filename, ".") != 0 && strcmp(filename, "..") != 0)
     success = (dir != NULL
-               && free_map_allocate (1, &inode_sector)
-               && inode_create (inode_sector, initial_size, isdir)
-               && dir_add (dir, filename, inode_sector));
+               && alloc_inode (dir, &inode_sector, initial_size, isdir,
+                               contiguous)
+               && dir_add (dir, filename, inode_sector, isdir));
   if (!success && inode_sector != 0) 
-    free_map_release (inode_sector, 1);
+    free_inode (inode_sector);
+  journal_end ();
   dir_close (dir);
-  free(filename);
   
   return success;
 }
 
+/* Creates an inode LENGTH bytes long for a new entry in DIR,
+   which is a directory if ISDIR is true, and stores its sector
+   in *SECTORP.  In a tmpfs directory, the inode is a tmpfs node
+   and *SECTORP is its inode number.  On failure, *SECTORP is
+   left nonzero if something must be given back with
+   free_inode().  CONTIGUOUS is as for create(). */
+static bool
+alloc_inode (struct dir *dir, block_sector_t *sectorp, off_t length,
+             bool isdir, bool contiguous)
+{
+  if (tmpfs_is_tmpfs (inode_get_inumber (dir_get_inode (dir))))
+    return tmpfs_create (sectorp, length, isdir);
+  return (free_map_allocate (1, sectorp)
+          && (contiguous
+              ? inode_create_contiguous (*sectorp, length)
+              : inode_create (*sectorp, length, isdir)));
+}
+
+/* Gives back SECTOR, allocated by alloc_inode() for an entry
+   that could not be added. */
+static void
+free_inode (block_sector_t sector)
+{
+  if (tmpfs_is_tmpfs (sector))
+    tmpfs_release (tmpfs_lookup (sector));
+  else
+    free_map_release (sector, 1);
+}
+
 /* Opens the file with the given NAME.
    Returns the new file if successful or a null pointer
    otherwise.
@@ -77,23 +142,19 @@ filesys_open (const char *name)
 {
   if(strlen(name) == 0)
     return NULL;
-  struct dir *dir = get_dir(name, false);
-  char* filename = get_filename(name);
+  char filename[NAME_MAX + 1];
+  struct dir *dir = get_dir(name, false, filename);
   struct inode *inode = NULL;
   if (dir != NULL)
   {
     if (strcmp(filename, "..") == 0)
     {
       if (!dir_get_parent(dir, &inode))
-      {
-        free(filename);
         return NULL;
-      }
     }
     else if ((dir_is_root(dir) && strlen(filename) == 0) ||
               strcmp(filename, ".") == 0)
     {
-      free(filename);
       return (struct file *) dir;
     }
     else {
@@ -101,7 +162,6 @@ filesys_open (const char *name)
     }
   }
   dir_close (dir);
-  free(filename);
   
   if (!inode) 
     return NULL;
@@ -119,11 +179,14 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = get_dir(name, false);
-  char* filename = get_filename(name);
-  bool success = dir != NULL && dir_remove (dir, filename);
+  char filename[NAME_MAX + 1];
+  struct dir *dir = get_dir(name, false, filename);
+  bool success;
+
+  journal_begin ();
+  success = dir != NULL && dir_remove (dir, filename);
+  journal_end ();
   dir_close (dir); 
-  free(filename);
   return success;
 }
 
@@ -135,41 +198,105 @@ do_format (void)
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
+  journal_create ();
   free_map_close ();
   printf ("done.\n");
 }
 
-struct dir* get_dir (const char* path, bool create)
+/* Extracts a file name part from *SRCP into PART, and updates
+   *SRCP so that the next call will return the next file name
+   part.  Returns 1 if successful, 0 at end of string, -1 for a
+   too-long file name part. */
+static int
+get_next_part (char part[NAME_MAX + 1], const char **srcp)
 {
-  char s[strlen(path) + 1];
-  memcpy(s, path, strlen(path) + 1);
+  const char *src = *srcp;
+  char *dst = part;
+
+  /* Skip leading slashes.  If it's all slashes, we're done. */
+  while (*src == '/')
+    src++;
+  if (*src == '\0')
+    return 0;
 
+  /* Copy up to NAME_MAX characters from SRC to DST.  Add null
+     terminator. */
+  while (*src != '/' && *src != '\0')
+    {
+      if (dst < part + NAME_MAX)
+        *dst++ = *src;
+      else
+        return -1;
+      src++;
+    }
+  *dst = '\0';
+
+  /* Advance source pointer. */
+  *srcp = src;
+  return 1;
+}
+
+/* Walks PATH, starting from the root directory if PATH is
+   absolute and from the current thread's working directory
+   otherwise, and returns the directory that contains PATH's last
+   component.  The last component itself is copied into NAME, or
+   NAME is set to "" if PATH has no components (e.g. "/").
+   If CREATE is true, missing intermediate directories are
+   created.  Returns a null pointer if an intermediate directory
+   is missing or a component is too long.  The path is scanned
+   once, in place, and each lookup goes through the directory
+   entry cache.  The caller must close the returned directory. */
+struct dir* get_dir (const char* path, bool create, char name[NAME_MAX + 1])
+{
   struct dir* dir;
-  if (s[0] == '/' || !thread_current()->cwd) 
+  int result = 0;
+
+  if (path[0] == '/' || !thread_current()->cwd) 
     dir = dir_open_root();
   else {
     dir = dir_reopen(thread_current()->cwd);
   }
-  char *save_ptr, *next_token, *token = strtok_r(s, "/", &save_ptr);
-  if (token)
-    next_token = strtok_r(NULL, "/", &save_ptr);
-  else
-    next_token = NULL;
-  while (next_token != NULL)
+
+  name[0] = '\0';
+  while (dir != NULL && (result = get_next_part (name, &path)) != 0)
   { 
     struct inode *inode;
-    if (!dir_lookup(dir, token, &inode)) {
-      if(!create) {
-        return NULL;
-      }
+    block_sector_t sector;
+    uint8_t type;
+
+    if (result < 0)
+      break;
+
+    /* Leave the last component to the caller. */
+    while (*path == '/')
+      path++;
+    if (*path == '\0')
+      return dir;
+
+    if (!dir_lookup_entry(dir, name, &sector, &type)) {
+      if(!create)
+        break;
       else {
-        block_sector_t inode_sector =0;
-        free_map_allocate(1, &inode_sector);
-        inode_create(inode_sector, 0, true); 
-        dir_add(dir, token, inode_sector);
-        dir_lookup(dir, token, &inode);
+        block_sector_t inode_sector = 0;
+
+        /* If another thread created NAME first, use its
+           directory and give back our sector. */
+        if ((!alloc_inode(dir, &inode_sector, 0, true, false)
+             || !dir_add(dir, name, inode_sector, true))
+            && inode_sector != 0)
+          free_inode(inode_sector);
+        if (!dir_lookup_entry(dir, name, &sector, &type))
+          break;
       }
     }
+
+    /* The entry's type says whether to descend, so files along
+       the path are skipped without reading their inodes. */
+    if (type == DT_REG)
+      continue;
+    inode = inode_open(sector);
+    if (inode == NULL)
+      break;
     if (inode_is_dir(inode))
     {  
       dir_close(dir);
@@ -179,30 +306,19 @@ struct dir* get_dir (const char* path, bool create)
     {
       inode_close(inode);
     }
-    token = next_token;
-    next_token = strtok_r(NULL, "/", &save_ptr);
+  }
+  if (dir != NULL && result != 0)
+  {
+    dir_close (dir);
+    dir = NULL;
   }
   return dir;
 }
 
-char* get_filename (const char* path)
-{
-  char s[strlen(path) + 1];
-  memcpy(s, path, strlen(path) + 1);
-
-  char *token, *save_ptr, *prev_token = "";
-  for (token = strtok_r(s, "/", &save_ptr); token != NULL;
-      token = strtok_r (NULL, "/", &save_ptr))
-    prev_token = token;
-  char *file_name = malloc(strlen(prev_token) + 1);
-  memcpy(file_name, prev_token, strlen(prev_token) + 1);
-  return file_name;
-}
-
 bool filesys_chdir (const char* name)
 {
-  struct dir* dir = get_dir(name, false);
-  char* file_name = get_filename(name);
+  char file_name[NAME_MAX + 1];
+  struct dir* dir = get_dir(name, false, file_name);
   struct inode *inode = NULL;
 
   if (dir != NULL)
@@ -210,16 +326,12 @@ bool filesys_chdir (const char* name)
       if (strcmp(file_name, "..") == 0)
 	{
 	  if (!dir_get_parent(dir, &inode))
-	    {
-	      free(file_name);
-	      return false;
-	    }
+	    return false;
 	}
       else if ((dir_is_root(dir) && strlen(file_name) == 0) ||
 	  strcmp(file_name, ".") == 0)
 	{
 	  thread_current()->cwd = dir;
-	  free(file_name);
 	  return true;
 	}
       else
@@ -229,7 +341,6 @@ bool filesys_chdir (const char* name)
     }
 
   dir_close (dir);
-  free(file_name);
 
   dir = dir_open (inode);
   if (dir)
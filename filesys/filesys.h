@@ -8,6 +8,7 @@
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define JOURNAL_SECTOR 2        /* Journal header sector. */
 
 /* Block device that contains the file system. */
 struct block *fs_device;
@@ -15,11 +16,11 @@ struct block *fs_device;
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size, bool isdir);
+bool filesys_create_contiguous (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
 
-struct dir* get_dir(const char *, bool create);
-char* get_filename(const char *);
+struct dir* get_dir(const char *, bool create, char name[NAME_MAX + 1]);
 
 bool filesys_chdir (const char* name);
 #endif /* filesys/filesys.h */
@@ -4,30 +4,55 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "filesys/tmpfs.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct lock free_map_lock;    /* Protects free_map. */
 
-/* Initializes the free map. */
+/* Initializes the free map.  Sectors at or past TMPFS_INODE_BASE
+   are left out of it, on a disk that large, so that they are never
+   allocated: their numbers are tmpfs inode numbers. */
 void
 free_map_init (void) 
 {
-  free_map = bitmap_create (block_size (fs_device));
+  block_sector_t sector_cnt = block_size (fs_device);
+
+  if (sector_cnt > TMPFS_INODE_BASE)
+    sector_cnt = TMPFS_INODE_BASE;
+  free_map = bitmap_create (sector_cnt);
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_mark (free_map, JOURNAL_SECTOR);
+  lock_init (&free_map_lock);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
+   Sectors freed by a transaction the journal has not committed
+   yet are not reused.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  block_sector_t sector = 0;
+
+  lock_acquire (&free_map_lock);
+  for (;;)
+    {
+      sector = bitmap_scan (free_map, sector, cnt, false);
+      if (sector == BITMAP_ERROR || journal_reusable (sector, cnt))
+        break;
+      sector++;
+    }
+  if (sector != BITMAP_ERROR)
+    bitmap_set_multiple (free_map, sector, cnt, true);
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
       && !bitmap_write (free_map, free_map_file))
@@ -35,18 +60,39 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
       bitmap_set_multiple (free_map, sector, cnt, false); 
       sector = BITMAP_ERROR;
     }
+  lock_release (&free_map_lock);
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use, once
+   the journal has committed the running transaction. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    journal_release (sector + i);
+
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
   bitmap_write (free_map, free_map_file);
+  lock_release (&free_map_lock);
+}
+
+/* Returns the number of sectors not in use. */
+size_t
+free_map_free_cnt (void)
+{
+  size_t cnt;
+
+  lock_acquire (&free_map_lock);
+  cnt = bitmap_count (free_map, 0, bitmap_size (free_map), false);
+  lock_release (&free_map_lock);
+  return cnt;
 }
 
 /* Opens the free map file and reads it from disk. */
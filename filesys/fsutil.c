@@ -1,5 +1,6 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,6 +8,7 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -68,18 +70,24 @@ fsutil_rm (char **argv)
 }
 
 /* Extracts a ustar-format tar archive from the scratch block
-   device into the Pintos file system. */
+   device into the Pintos file system.
+
+   Each file is created at its full size up front, with its data
+   laid out contiguously where possible, and is then loaded a
+   page of sectors at a time straight from the scratch device
+   into its data sectors, bypassing the buffer cache. */
 void
 fsutil_extract (char **argv UNUSED) 
 {
   static block_sector_t sector = 0;
 
   struct block *src;
-  void *header, *data;
+  void *header;
+  uint8_t *data;
 
   /* Allocate buffers. */
   header = malloc (BLOCK_SECTOR_SIZE);
-  data = malloc (BLOCK_SECTOR_SIZE);
+  data = palloc_get_page (0);
   if (header == NULL || data == NULL)
     PANIC ("couldn't allocate buffers");
 
@@ -114,27 +122,32 @@ fsutil_extract (char **argv UNUSED)
       else if (type == USTAR_REGULAR)
         {
           struct file *dst;
+          off_t ofs = 0;
 
           printf ("Putting '%s' into the file system...\n", file_name);
 
           /* Create destination file. */
-          if (!filesys_create (file_name, size, false))
+          if (!filesys_create_contiguous (file_name, size))
             PANIC ("%s: create failed", file_name);
           dst = filesys_open (file_name);
           if (dst == NULL)
             PANIC ("%s: open failed", file_name);
+          if (file_length (dst) != size)
+            PANIC ("%s: only %"PROTd" of %d bytes allocated",
+                   file_name, file_length (dst), size);
 
-          /* Do copy. */
-          while (size > 0)
+          /* Do copy.  The archive pads the last sector with
+             zeros. */
+          while (ofs < size)
             {
-              int chunk_size = (size > BLOCK_SECTOR_SIZE
-                                ? BLOCK_SECTOR_SIZE
-                                : size);
-              block_read (src, sector++, data);
-              if (file_write (dst, data, chunk_size) != chunk_size)
-                PANIC ("%s: write failed with %d bytes unwritten",
-                       file_name, size);
-              size -= chunk_size;
+              size_t cnt = DIV_ROUND_UP (size - ofs, BLOCK_SECTOR_SIZE);
+
+              if (cnt > PGSIZE / BLOCK_SECTOR_SIZE)
+                cnt = PGSIZE / BLOCK_SECTOR_SIZE;
+              block_read_multiple (src, sector, cnt, data);
+              sector += cnt;
+              inode_write_sectors (file_get_inode (dst), data, cnt, ofs);
+              ofs += cnt * BLOCK_SECTOR_SIZE;
             }
 
           /* Finish up. */
@@ -151,7 +164,7 @@ fsutil_extract (char **argv UNUSED)
   block_write (src, 0, header);
   block_write (src, 1, header);
 
-  free (data);
+  palloc_free_page (data);
   free (header);
 }
 
@@ -6,12 +6,36 @@
 #include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/lz.h"
+#include "filesys/tmpfs.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Most sectors moved by one step of a direct transfer, the
+   number that fit in its bounce buffer. */
+#define DIRECT_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Longest file allowed, in bytes. */
+#define INODE_MAX_LENGTH 8980480
+
+/* A compressed file is compressed a chunk at a time.  A chunk is
+   one page, so that it decompresses into a page. */
+#define CHUNK_SIZE PGSIZE
+#define CHUNK_SECTORS (CHUNK_SIZE / BLOCK_SECTOR_SIZE)
+
+/* Start of a chunk stored compressed. */
+struct chunk_header
+{
+  uint16_t packed_len;                /* Bytes of compressed data. */
+  uint16_t data_len;                  /* Bytes they decompress to. */
+};
+
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct data_group
@@ -24,6 +48,7 @@ struct data_group
   int i_dir;
   int i_indir;
   int i_doubly;
+  bool compressed;
 };
 
 struct inode_disk
@@ -31,7 +56,8 @@ struct inode_disk
   block_sector_t parent;               /* First data sector. */
   off_t length;                       /* File size in bytes. */
   unsigned magic;                     /* Magic number. */
-  uint32_t unused[111];               /* Not used. */
+  uint32_t unused[110];               /* Not used. */
+  bool compressed;                    /* Stored in compressed chunks? */
   block_sector_t ptr[10];
   bool isdir;
   int i_dir;
@@ -50,11 +76,47 @@ struct inode
   int open_cnt;                       /* Number of openers. */
   bool removed;                       /* True if deleted, false otherwise. */
   int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+  struct lock lock;                   /* Serializes directory changes. */
   struct data_group data;
   off_t read_length;
+  block_sector_t run_start;           /* Next sector of preallocated run. */
+  size_t run_left;                    /* Sectors left in the run. */
+  bool zero_fill;                     /* Zero newly allocated sectors? */
+  bool meta_dirty;                    /* Allocation changed since sync? */
+  struct tmpfs_node *mem;             /* Tmpfs node, or null if on disk. */
+  bool loaded;                        /* DATA read from disk yet? */
+  uint8_t *chunk;                     /* Decompressed chunk, or null. */
+  size_t chunk_idx;                   /* Which chunk is in CHUNK. */
+  bool chunk_dirty;                   /* CHUNK changed since loaded? */
 };
 
-bool inode_alloc (struct inode_disk *disk_inode);
+static void inode_flush (struct inode *inode);
+static bool inode_create_common (block_sector_t, off_t, bool isdir,
+                                 bool contiguous);
+static bool allocate_data_sector (struct inode *, block_sector_t *);
+static void inode_transfer_direct (struct inode *, off_t length,
+                                   uint8_t *bounce, size_t cnt,
+                                   off_t offset, bool write);
+static void inode_grow_for_write (struct inode *, off_t offset, off_t size);
+static void inode_extend (struct inode *, off_t new_length);
+static void inode_shrink (struct inode *, off_t new_length);
+static off_t inode_read_mem (struct inode *, const struct iovec *,
+                             size_t iov_cnt, off_t offset);
+static off_t inode_write_mem (struct inode *, const struct iovec *,
+                              size_t iov_cnt, off_t offset);
+static off_t inode_read_chunked (struct inode *, const struct iovec *,
+                                 size_t iov_cnt, off_t offset);
+static off_t inode_write_chunked (struct inode *, const struct iovec *,
+                                  size_t iov_cnt, off_t offset);
+static bool chunk_load (struct inode *, size_t idx);
+static void chunk_flush (struct inode *);
+static void chunk_sync (struct inode *);
+static void chunk_cut (struct inode *, off_t length);
+static off_t inode_copy_bounce (struct inode *dst, off_t dst_ofs,
+                                struct inode *src, off_t src_ofs,
+                                off_t size);
+bool inode_alloc (struct inode_disk *disk_inode, block_sector_t sector,
+                  bool contiguous);
 off_t inode_expand (struct inode *inode, off_t new_length);
 size_t inode_expand_indirect_block (struct inode *inode,
     size_t new_data_sectors);
@@ -99,6 +161,19 @@ static size_t bytes_to_double_indirect_sector (off_t size)
   return 1;
 }
 
+/* Returns the number of data sectors allocated to INODE.  That
+   is more than its length needs if space past end of file was
+   reserved by inode_allocate(). */
+static size_t
+allocated_sectors (const struct inode *inode)
+{
+  if (inode->data.i_dir < 8)
+    return inode->data.i_dir;
+  if (inode->data.i_dir == 8)
+    return 8 + inode->data.i_indir;
+  return 8 + 128 + inode->data.i_indir * 128 + inode->data.i_doubly;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -120,18 +195,17 @@ byte_to_sector (const struct inode *inode, off_t length, off_t pos)
     {
       pos -= BLOCK_SECTOR_SIZE*8;
       idx = pos / (BLOCK_SECTOR_SIZE*128) + 8;
-      block_read(fs_device, inode->data.ptr[idx], &indirect_block);
+      cache_read(inode->data.ptr[idx], &indirect_block);
       pos %= BLOCK_SECTOR_SIZE*128;
       return indirect_block[pos / BLOCK_SECTOR_SIZE];
     }
     else
     {
-      block_read(fs_device, inode->data.ptr[9],
-	  &indirect_block);
+      cache_read(inode->data.ptr[9], &indirect_block);
       pos -= BLOCK_SECTOR_SIZE*(8 +
 	  1*128);
       idx = pos / (BLOCK_SECTOR_SIZE*128);
-      block_read(fs_device, indirect_block[idx], &indirect_block);
+      cache_read(indirect_block[idx], &indirect_block);
       pos %= BLOCK_SECTOR_SIZE*128;
       return indirect_block[pos / BLOCK_SECTOR_SIZE];
     }
@@ -146,11 +220,20 @@ byte_to_sector (const struct inode *inode, off_t length, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes and the open counts of its members. */
+static struct lock open_inodes_lock;
+
+/* Signaled, with open_inodes_lock, when an inode finishes
+   loading. */
+static struct condition inode_loaded;
+
 /* Initializes the inode module. */
   void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  lock_init (&open_inodes_lock);
+  cond_init (&inode_loaded);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -160,6 +243,27 @@ inode_init (void)
    Returns false if memory or disk allocation fails. */
 bool
 inode_create (block_sector_t sector, off_t length, bool isdir)
+{
+  return inode_create_common (sector, length, isdir, false);
+}
+
+/* Initializes a regular file inode with LENGTH bytes of data,
+   laid out in consecutive sectors if a long enough run is free,
+   and writes the new inode to sector SECTOR.  The data is not
+   zeroed, because the caller is about to overwrite all of it,
+   typically with inode_write_sectors().
+   Returns true if successful.
+   Returns false if memory or disk allocation fails. */
+bool
+inode_create_contiguous (block_sector_t sector, off_t length)
+{
+  return inode_create_common (sector, length, false, true);
+}
+
+/* Does the work of inode_create() and inode_create_contiguous(). */
+static bool
+inode_create_common (block_sector_t sector, off_t length, bool isdir,
+                     bool contiguous)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -174,16 +278,16 @@ inode_create (block_sector_t sector, off_t length, bool isdir)
   if (disk_inode != NULL)
   {
     disk_inode->length = length;
-    if (disk_inode->length > 8980480)
+    if (disk_inode->length > INODE_MAX_LENGTH)
     {
-      disk_inode->length = 8980480;
+      disk_inode->length = INODE_MAX_LENGTH;
     }
     disk_inode->magic = INODE_MAGIC;
     disk_inode->isdir = isdir;
     disk_inode->parent = ROOT_DIR_SECTOR;
-    if (inode_alloc(disk_inode)) 
+    if (inode_alloc(disk_inode, sector, contiguous)) 
     {
-      block_write (fs_device, sector, disk_inode);
+      journal_write (sector, disk_inode);
       success = true; 
     }
     free (disk_inode);
@@ -191,7 +295,11 @@ inode_create (block_sector_t sector, off_t length, bool isdir)
   return success;
 }
 
-struct inode* inode_is_open(block_sector_t sector) {
+/* Returns the open inode for SECTOR, or a null pointer if it is
+   not open.  The caller must hold open_inodes_lock. */
+static struct inode *
+find_open_inode (block_sector_t sector)
+{
   struct list_elem *e;
   struct inode *inode;
 
@@ -204,24 +312,62 @@ struct inode* inode_is_open(block_sector_t sector) {
   return NULL;
 }
 
+struct inode* inode_is_open(block_sector_t sector) {
+  struct inode *inode;
+
+  lock_acquire (&open_inodes_lock);
+  inode = find_open_inode (sector);
+  lock_release (&open_inodes_lock);
+  return inode;
+}
+
 /* Reads an inode from SECTOR
-   and returns a `struct inode' that contains it.
-   Returns a null pointer if memory allocation fails. */
+   and returns a `struct inode' that contains it.  If a tmpfs is
+   mounted over the directory in SECTOR, opens the tmpfs root
+   instead.  SECTOR may also be the inode number of a tmpfs node.
+   Returns a null pointer if memory allocation fails or there is
+   no such tmpfs node.
+
+   The inode is put on the open list before it is read, and read
+   without holding open_inodes_lock, so that opens of other
+   inodes need not wait for the disk.  Opens of the same inode
+   wait for the read to finish. */
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct inode* inode = inode_is_open(sector);
-  
+  struct inode* inode;
+  struct tmpfs_node *mem = NULL;
+
+  sector = tmpfs_covered (sector);
+  if (tmpfs_is_tmpfs (sector))
+  {
+    mem = tmpfs_lookup (sector);
+    if (mem == NULL)
+      return NULL;
+  }
+
+  lock_acquire (&open_inodes_lock);
+  inode = find_open_inode (sector);
   if(inode)
   {
-    inode_reopen (inode);
+    inode->open_cnt++;
+    while (!inode->loaded)
+      cond_wait (&inode_loaded, &open_inodes_lock);
+    lock_release (&open_inodes_lock);
+    if (mem != NULL)
+      tmpfs_put (mem);
     return inode; 
   }
   
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
+  {
+    lock_release (&open_inodes_lock);
+    if (mem != NULL)
+      tmpfs_put (mem);
     return NULL;
+  }
 
   /* Initialize. */
   list_push_front (&open_inodes, &inode->elem);
@@ -229,8 +375,28 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->run_left = 0;
+  inode->zero_fill = true;
+  inode->meta_dirty = true;
+  inode->mem = mem;
+  inode->loaded = mem != NULL;
+  inode->chunk = NULL;
+  inode->chunk_dirty = false;
+  lock_init (&inode->lock);
+  if (mem != NULL)
+  {
+    memset (&inode->data, 0, sizeof inode->data);
+    inode->read_length = mem->length;
+    inode->data.length = mem->length;
+    inode->data.isdir = mem->isdir;
+    inode->data.parent = mem->parent;
+    lock_release (&open_inodes_lock);
+    return inode;
+  }
+  lock_release (&open_inodes_lock);
+
   struct inode_disk data;
-  block_read(fs_device, inode->sector, &data);
+  cache_read(inode->sector, &data);
   inode->read_length = data.length;
   inode->data.length = data.length;
   inode->data.i_dir = data.i_dir;
@@ -238,7 +404,13 @@ inode_open (block_sector_t sector)
   inode->data.i_doubly = data.i_doubly;	
   inode->data.isdir = data.isdir;
   inode->data.parent = data.parent;
+  inode->data.compressed = data.compressed;
   memcpy(&inode->data.ptr, &data.ptr, 10*sizeof(block_sector_t));
+
+  lock_acquire (&open_inodes_lock);
+  inode->loaded = true;
+  cond_broadcast (&inode_loaded, &open_inodes_lock);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -247,7 +419,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
+  {
+    lock_acquire (&open_inodes_lock);
     inode->open_cnt++;
+    lock_release (&open_inodes_lock);
+  }
   return inode;
 }
 
@@ -267,21 +443,64 @@ inode_close (struct inode *inode)
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
+
+  /* Store a compressed file's current chunk while the inode can
+     still be found, so that whoever opens it next sees it. */
+  if (inode->chunk != NULL && !inode->removed)
+    chunk_sync (inode);
+
   /* Release resources if this was the last opener. */
+  lock_acquire (&open_inodes_lock);
   if (--inode->open_cnt == 0)
   {
     /* Remove from inode list and release lock. */
     list_remove (&inode->elem);
+    lock_release (&open_inodes_lock);
+    if (inode->chunk != NULL)
+      palloc_free_page (inode->chunk);
 
     /* Deallocate blocks if removed. */
-    if (inode->removed) 
+    if (inode->removed && inode->mem != NULL)
+      tmpfs_release (inode->mem);
+    else if (inode->mem != NULL)
+      tmpfs_put (inode->mem);
+    else if (inode->removed) 
     {
+      journal_begin ();
       free_map_release (inode->sector, 1);
       inode_dealloc(inode);
+      journal_end ();
     }
 
     free (inode); 
   }
+  else
+    lock_release (&open_inodes_lock);
+}
+
+/* Returns true if INODE has been marked for deletion. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
+/* Acquires INODE's lock, which serializes changes to the
+   contents of a directory.  Independent directories have
+   independent locks.  A thread holding the locks of both a
+   directory and one of its children must have acquired the
+   parent's first. */
+void
+inode_lock (struct inode *inode)
+{
+  lock_acquire (&inode->lock);
+}
+
+/* Releases INODE's lock. */
+void
+inode_unlock (struct inode *inode)
+{
+  lock_release (&inode->lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -297,20 +516,47 @@ inode_remove (struct inode *inode)
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
   off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  struct iovec iov;
+
+  if (size <= 0)
+    return 0;
+  iov.iov_base = buffer;
+  iov.iov_len = size;
+  return inode_read_iov (inode, &iov, 1, offset);
+}
+
+/* Reads from INODE into the IOV_CNT buffers in IOV, filling each
+   in turn, starting at position OFFSET.  Each sector is looked up
+   once, however many buffers it spans.  Returns the number of
+   bytes actually read, which may be less than the buffers' total
+   size if end of file is reached. */
+  off_t
+inode_read_iov (struct inode *inode, const struct iovec *iov,
+    size_t iov_cnt, off_t offset)
 {
-  uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
+  size_t iov_ofs = 0;
 
   off_t length = inode->read_length;
 
-  if (offset >= length)
+  if (inode->mem != NULL)
+    return inode_read_mem (inode, iov, iov_cnt, offset);
+  if (inode->data.compressed)
+    return inode_read_chunked (inode, iov, iov_cnt, offset);
+  while (offset < length)
   {
-    return bytes_read;
-  }
+    /* Skip buffers that are full or empty. */
+    while (iov_cnt > 0 && iov_ofs == iov->iov_len)
+    {
+      iov++;
+      iov_cnt--;
+      iov_ofs = 0;
+    }
+    if (iov_cnt == 0)
+      break;
 
-  while (size > 0) 
-  {
     /* Disk sector to read, starting byte offset within sector. */
     block_sector_t sector_idx = byte_to_sector (inode, length, offset);
     int sector_ofs = offset % BLOCK_SECTOR_SIZE;
@@ -320,21 +566,31 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
     int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
     int min_left = inode_left < sector_left ? inode_left : sector_left;
 
-    /* Number of bytes to actually copy out of this sector. */
-    int chunk_size = size < min_left ? size : min_left;
-    if (chunk_size <= 0)
-      break;
-
+    /* Copy as much of the sector as the buffers want. */
     struct cache_entry *c = check_cache(sector_idx, false);
-    memcpy (buffer + bytes_read, (uint8_t *) &c->block + sector_ofs,
-	chunk_size);
+    while (min_left > 0 && iov_cnt > 0)
+    {
+      size_t chunk_size = iov->iov_len - iov_ofs;
+      if (chunk_size > (size_t) min_left)
+        chunk_size = min_left;
+      memcpy ((uint8_t *) iov->iov_base + iov_ofs,
+          (uint8_t *) &c->block + sector_ofs, chunk_size);
+
+      /* Advance. */
+      sector_ofs += chunk_size;
+      min_left -= chunk_size;
+      offset += chunk_size;
+      bytes_read += chunk_size;
+      iov_ofs += chunk_size;
+      if (iov_ofs == iov->iov_len)
+      {
+        iov++;
+        iov_cnt--;
+        iov_ofs = 0;
+      }
+    }
     c->accessed = true;
     c->open_cnt--;
-
-    /* Advance. */
-    size -= chunk_size;
-    offset += chunk_size;
-    bytes_read += chunk_size;
   }
 
   return bytes_read;
@@ -343,23 +599,66 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   A write past end of file extends the inode.  The contents of
+   directories and of the free map are metadata, so writes to
+   them are journaled. */
   off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
     off_t offset) 
 {
-  const uint8_t *buffer = buffer_;
+  struct iovec iov;
+
+  if (size <= 0)
+    return 0;
+  iov.iov_base = (void *) buffer;
+  iov.iov_len = size;
+  return inode_write_iov (inode, &iov, 1, offset);
+}
+
+/* Writes the contents of the IOV_CNT buffers in IOV into INODE,
+   one after another, starting at OFFSET, like inode_write_at().
+   The inode is extended once for the whole write and each sector
+   is looked up once, however many buffers it spans.  Returns the
+   number of bytes actually written. */
+  off_t
+inode_write_iov (struct inode *inode, const struct iovec *iov,
+    size_t iov_cnt, off_t offset)
+{
   off_t bytes_written = 0;
+  size_t iov_ofs = 0;
+  off_t size = 0;
+  bool journaled = inode->data.isdir || inode->sector == FREE_MAP_SECTOR;
+  size_t i;
 
   if (inode->deny_write_cnt)
     return 0;
+  if (inode->mem != NULL)
+    return inode_write_mem (inode, iov, iov_cnt, offset);
+  if (inode->data.compressed)
+    return inode_write_chunked (inode, iov, iov_cnt, offset);
+
+  for (i = 0; i < iov_cnt; i++)
+    size += iov[i].iov_len;
 
+  journal_begin ();
   if (offset + size > inode_length(inode))
+  {
     inode->data.length = inode_expand(inode, offset + size);
+    inode_flush (inode);
+  }
 
-  while (size > 0) 
+  while (offset < inode_length(inode))
   {
+    /* Skip buffers that are used up or empty. */
+    while (iov_cnt > 0 && iov_ofs == iov->iov_len)
+    {
+      iov++;
+      iov_cnt--;
+      iov_ofs = 0;
+    }
+    if (iov_cnt == 0)
+      break;
+
     /* Sector to write, starting byte offset within sector. */
     block_sector_t sector_idx = byte_to_sector (inode,
 	inode_length(inode),
@@ -371,28 +670,982 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
     int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
     int min_left = inode_left < sector_left ? inode_left : sector_left;
 
-    /* Number of bytes to actually write into this sector. */
-    int chunk_size = size < min_left ? size : min_left;
-    if (chunk_size <= 0)
-      break;
-
+    /* Fill as much of the sector as the buffers have. */
     struct cache_entry *c = check_cache(sector_idx, true);
-    memcpy ((uint8_t *) &c->block + sector_ofs, buffer + bytes_written,
-	chunk_size);
+    while (min_left > 0 && iov_cnt > 0)
+    {
+      size_t chunk_size = iov->iov_len - iov_ofs;
+      if (chunk_size > (size_t) min_left)
+        chunk_size = min_left;
+      memcpy ((uint8_t *) &c->block + sector_ofs,
+          (const uint8_t *) iov->iov_base + iov_ofs, chunk_size);
+
+      /* Advance. */
+      sector_ofs += chunk_size;
+      min_left -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+      iov_ofs += chunk_size;
+      if (iov_ofs == iov->iov_len)
+      {
+        iov++;
+        iov_cnt--;
+        iov_ofs = 0;
+      }
+    }
     c->accessed = true;
     c->dirty = true;
+    c->owner = inode->sector;
+    if (journaled)
+      journal_log (sector_idx, c->block);
     c->open_cnt--;
+  }
+
+  inode->read_length = inode_length(inode);
+  journal_end ();
+  return bytes_written;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at OFFSET,
+   like inode_read_at(), except that whole sectors are read
+   straight from disk into a bounce buffer instead of through the
+   buffer cache, so that a long streaming read does not evict
+   everything else from the cache.  Partial sectors at either
+   end still go through the cache. */
+off_t
+inode_read_direct (struct inode *inode, void *buffer_, off_t size,
+                   off_t offset)
+{
+  uint8_t *buffer = buffer_;
+  off_t length = inode->read_length;
+  off_t first, last, pos;
+  uint8_t *bounce;
+
+  if (offset >= length)
+    return 0;
+  if (size > length - offset)
+    size = length - offset;
+
+  first = ROUND_UP (offset, BLOCK_SECTOR_SIZE);
+  last = ROUND_DOWN (offset + size, BLOCK_SECTOR_SIZE);
+  if (last <= first || inode->mem != NULL || inode->data.compressed)
+    return inode_read_at (inode, buffer, size, offset);
+  bounce = palloc_get_page (0);
+  if (bounce == NULL)
+    return inode_read_at (inode, buffer, size, offset);
+
+  inode_read_at (inode, buffer, first - offset, offset);
+  for (pos = first; pos < last; )
+  {
+    size_t cnt = (last - pos) / BLOCK_SECTOR_SIZE;
+    if (cnt > DIRECT_SECTORS)
+      cnt = DIRECT_SECTORS;
+    inode_transfer_direct (inode, length, bounce, cnt, pos, false);
+    memcpy (buffer + (pos - offset), bounce, cnt * BLOCK_SECTOR_SIZE);
+    pos += cnt * BLOCK_SECTOR_SIZE;
+  }
+  inode_read_at (inode, buffer + (last - offset), offset + size - last,
+                 last);
+
+  palloc_free_page (bounce);
+  return size;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+   like inode_write_at(), except that whole sectors go straight
+   to disk from a bounce buffer instead of through the buffer
+   cache.  Cached copies of those sectors are kept up to date.
+   Partial sectors at either end, writes to metadata, and whatever
+   the direct path could not cover because the disk filled up
+   still go through the cache.  Returns the number of bytes
+   actually written. */
+off_t
+inode_write_direct (struct inode *inode, const void *buffer_, off_t size,
+                    off_t offset)
+{
+  const uint8_t *buffer = buffer_;
+  off_t first = ROUND_UP (offset, BLOCK_SECTOR_SIZE);
+  off_t last = ROUND_DOWN (offset + size, BLOCK_SECTOR_SIZE);
+  off_t pos, end, written;
+  uint8_t *bounce;
+
+  if (inode->deny_write_cnt)
+    return 0;
+  if (inode->data.isdir || inode->sector == FREE_MAP_SECTOR || last <= first
+      || inode->mem != NULL || inode->data.compressed)
+    return inode_write_at (inode, buffer, size, offset);
+  bounce = palloc_get_page (0);
+  if (bounce == NULL)
+    return inode_write_at (inode, buffer, size, offset);
+
+  journal_begin ();
+  inode_grow_for_write (inode, offset, size);
+
+  /* Write the whole sectors first, so that readers never see
+     allocated but unwritten sectors, then the partial ones.  If
+     the disk filled up, stop at the end of the file and leave the
+     rest to inode_write_at(), which writes as much as fits. */
+  end = ROUND_DOWN (inode_length (inode), BLOCK_SECTOR_SIZE);
+  if (end > last)
+    end = last;
+  for (pos = first; pos < end; )
+  {
+    size_t cnt = (end - pos) / BLOCK_SECTOR_SIZE;
+    if (cnt > DIRECT_SECTORS)
+      cnt = DIRECT_SECTORS;
+    memcpy (bounce, buffer + (pos - offset), cnt * BLOCK_SECTOR_SIZE);
+    inode_transfer_direct (inode, inode_length (inode), bounce, cnt, pos,
+                           true);
+    pos += cnt * BLOCK_SECTOR_SIZE;
+  }
+  written = inode_write_at (inode, buffer, first - offset, offset);
+  if (written == first - offset)
+    written += (pos - first) + inode_write_at (inode, buffer + (pos - offset),
+                                               offset + size - pos, pos);
+
+  inode->read_length = inode_length (inode);
+  journal_end ();
+  palloc_free_page (bounce);
+  return written;
+}
+
+/* Copies up to SIZE bytes from SRC, starting at SRC_OFS, into
+   DST, starting at DST_OFS, without going through a caller's
+   buffer, and returns the number of bytes copied.  DST is
+   extended once, up front, for the whole copy.  Each whole sector
+   of DST is filled without reading its old contents; when the two
+   offsets are equally aligned, that is a copy from one cache
+   entry to another.  DST must be a regular file, and the two
+   ranges must not overlap if SRC and DST are the same inode. */
+off_t
+inode_copy (struct inode *dst, off_t dst_ofs, struct inode *src,
+            off_t src_ofs, off_t size)
+{
+  off_t src_length = src->read_length;
+  off_t bytes_copied = 0;
+  uint8_t *block;
+
+  ASSERT (!dst->data.isdir);
+
+  if (dst->deny_write_cnt || src_ofs >= src_length || size <= 0)
+    return 0;
+  if (size > src_length - src_ofs)
+    size = src_length - src_ofs;
+  if (dst->mem != NULL || src->mem != NULL
+      || dst->data.compressed || src->data.compressed)
+    return inode_copy_bounce (dst, dst_ofs, src, src_ofs, size);
+  block = malloc (BLOCK_SECTOR_SIZE);
+  if (block == NULL)
+    return 0;
+
+  journal_begin ();
+  inode_grow_for_write (dst, dst_ofs, size);
+  if (size > inode_length (dst) - dst_ofs)
+    size = inode_length (dst) - dst_ofs;
+
+  while (bytes_copied < size)
+  {
+    off_t dst_pos = dst_ofs + bytes_copied;
+    off_t src_pos = src_ofs + bytes_copied;
+    block_sector_t dst_sector = byte_to_sector (dst, inode_length (dst),
+                                                dst_pos);
+    int sector_ofs = dst_pos % BLOCK_SECTOR_SIZE;
+    int chunk_size = BLOCK_SECTOR_SIZE - sector_ofs;
+    if (chunk_size > size - bytes_copied)
+      chunk_size = size - bytes_copied;
+
+    if (chunk_size == BLOCK_SECTOR_SIZE
+        && src_pos % BLOCK_SECTOR_SIZE == 0)
+    {
+      /* Whole sector to whole sector. */
+      struct cache_entry *c = check_cache (byte_to_sector (src, src_length,
+                                                           src_pos), false);
+      cache_write (dst_sector, c->block, dst->sector);
+      c->accessed = true;
+      c->open_cnt--;
+    }
+    else if (chunk_size == BLOCK_SECTOR_SIZE)
+    {
+      inode_read_at (src, block, chunk_size, src_pos);
+      cache_write (dst_sector, block, dst->sector);
+    }
+    else
+    {
+      struct cache_entry *c;
+
+      inode_read_at (src, block, chunk_size, src_pos);
+      c = check_cache (dst_sector, true);
+      memcpy ((uint8_t *) &c->block + sector_ofs, block, chunk_size);
+      c->accessed = true;
+      c->owner = dst->sector;
+      c->open_cnt--;
+    }
+    bytes_copied += chunk_size;
+  }
+
+  dst->read_length = inode_length (dst);
+  journal_end ();
+  free (block);
+  return bytes_copied;
+}
+
+/* Reads from tmpfs INODE into the IOV_CNT buffers in IOV, like
+   inode_read_iov(). */
+static off_t
+inode_read_mem (struct inode *inode, const struct iovec *iov,
+                size_t iov_cnt, off_t offset)
+{
+  off_t length = inode->read_length;
+  off_t bytes_read = 0;
+
+  for (; iov_cnt > 0 && offset < length; iov++, iov_cnt--)
+  {
+    off_t size = iov->iov_len;
+    if (size > length - offset)
+      size = length - offset;
+    tmpfs_read (inode->mem, iov->iov_base, size, offset);
+    offset += size;
+    bytes_read += size;
+  }
+  return bytes_read;
+}
+
+/* Writes the IOV_CNT buffers in IOV into tmpfs INODE, like
+   inode_write_iov().  Stops early if memory runs out. */
+static off_t
+inode_write_mem (struct inode *inode, const struct iovec *iov,
+                 size_t iov_cnt, off_t offset)
+{
+  off_t bytes_written = 0;
+
+  for (; iov_cnt > 0; iov++, iov_cnt--)
+  {
+    off_t size = iov->iov_len;
+    off_t written = tmpfs_write (inode->mem, iov->iov_base, size, offset);
+    offset += written;
+    bytes_written += written;
+    if (written < size)
+      break;
+  }
+  if (offset > inode_length (inode))
+  {
+    inode->data.length = offset;
+    inode_flush (inode);
+  }
+  inode->read_length = inode_length (inode);
+  return bytes_written;
+}
+
+/* Copies SIZE bytes from SRC to DST through a bounce page, for
+   inode_copy() to or from the tmpfs or a compressed file, whose
+   data is not kept one sector per sector. */
+static off_t
+inode_copy_bounce (struct inode *dst, off_t dst_ofs, struct inode *src,
+                   off_t src_ofs, off_t size)
+{
+  uint8_t *bounce = palloc_get_page (0);
+  off_t bytes_copied = 0;
+
+  if (bounce == NULL)
+    return 0;
+  while (bytes_copied < size)
+  {
+    off_t chunk_size = size - bytes_copied;
+    off_t written;
+    if (chunk_size > PGSIZE)
+      chunk_size = PGSIZE;
+
+    chunk_size = inode_read_at (src, bounce, chunk_size,
+                                src_ofs + bytes_copied);
+    written = inode_write_at (dst, bounce, chunk_size,
+                              dst_ofs + bytes_copied);
+    bytes_copied += written;
+    if (written == 0 || written < chunk_size)
+      break;
+  }
+  palloc_free_page (bounce);
+  return bytes_copied;
+}
+
+/* Marks INODE, a regular file on disk, to be stored compressed
+   from now on.  Its existing data stays as it is until it is
+   rewritten.  Returns true if successful, false if INODE cannot
+   be compressed. */
+bool
+inode_set_compressed (struct inode *inode)
+{
+  if (inode->data.isdir || inode->sector == FREE_MAP_SECTOR
+      || inode->mem != NULL)
+    return false;
+  if (!inode->data.compressed)
+  {
+    journal_begin ();
+    inode->data.compressed = true;
+    inode_flush (inode);
+    journal_end ();
+  }
+  return true;
+}
+
+/* Returns the sector that holds data sector IDX of INODE, or 0
+   if it is a hole left by a compressed chunk. */
+static block_sector_t
+get_slot (const struct inode *inode, size_t idx)
+{
+  return byte_to_sector (inode, (idx + 1) * BLOCK_SECTOR_SIZE,
+                         idx * BLOCK_SECTOR_SIZE);
+}
 
-    /* Advance. */
-    size -= chunk_size;
+/* Makes SECTOR, or a hole if it is 0, data sector IDX of INODE,
+   which must already have been allocated.  Journals the change. */
+static void
+set_slot (struct inode *inode, size_t idx, block_sector_t sector)
+{
+  struct indir_block block;
+  block_sector_t block_sector;
+
+  if (idx < 8)
+  {
+    inode->data.ptr[idx] = sector;
+    inode_flush (inode);
+    return;
+  }
+  if (idx < 8 + 128)
+  {
+    block_sector = inode->data.ptr[8];
+    idx -= 8;
+  }
+  else
+  {
+    idx -= 8 + 128;
+    cache_read (inode->data.ptr[9], &block);
+    block_sector = block.ptr[idx / 128];
+    idx %= 128;
+  }
+  cache_read (block_sector, &block);
+  block.ptr[idx] = sector;
+  journal_write (block_sector, &block);
+  inode->meta_dirty = true;
+}
+
+/* Returns the number of INODE's data sectors in chunk IDX. */
+static size_t
+chunk_sectors (struct inode *inode, size_t idx)
+{
+  size_t data_sectors = bytes_to_data_sectors (inode_length (inode));
+  size_t first = idx * CHUNK_SECTORS;
+
+  if (first >= data_sectors)
+    return 0;
+  return data_sectors - first < CHUNK_SECTORS ? data_sectors - first
+                                               : CHUNK_SECTORS;
+}
+
+/* Reads from compressed INODE into the IOV_CNT buffers in IOV,
+   like inode_read_iov(), a decompressed chunk at a time. */
+static off_t
+inode_read_chunked (struct inode *inode, const struct iovec *iov,
+                    size_t iov_cnt, off_t offset)
+{
+  off_t length = inode->read_length;
+  off_t bytes_read = 0;
+  size_t iov_ofs = 0;
+
+  journal_begin ();
+  inode_lock (inode);
+  while (offset < length)
+  {
+    int chunk_ofs = offset % CHUNK_SIZE;
+    off_t chunk_size = CHUNK_SIZE - chunk_ofs;
+
+    while (iov_cnt > 0 && iov_ofs == iov->iov_len)
+    {
+      iov++;
+      iov_cnt--;
+      iov_ofs = 0;
+    }
+    if (iov_cnt == 0 || !chunk_load (inode, offset / CHUNK_SIZE))
+      break;
+
+    if (chunk_size > length - offset)
+      chunk_size = length - offset;
+    if (chunk_size > (off_t) (iov->iov_len - iov_ofs))
+      chunk_size = iov->iov_len - iov_ofs;
+    memcpy ((uint8_t *) iov->iov_base + iov_ofs, inode->chunk + chunk_ofs,
+            chunk_size);
     offset += chunk_size;
-    bytes_written += chunk_size;
+    bytes_read += chunk_size;
+    iov_ofs += chunk_size;
   }
+  inode_unlock (inode);
+  journal_end ();
+  return bytes_read;
+}
 
-  inode->read_length = inode_length(inode);
+/* Writes the IOV_CNT buffers in IOV into compressed INODE, like
+   inode_write_iov(), a decompressed chunk at a time.  A chunk is
+   compressed and stored when another one is needed, and when
+   INODE is synced or closed. */
+static off_t
+inode_write_chunked (struct inode *inode, const struct iovec *iov,
+                     size_t iov_cnt, off_t offset)
+{
+  off_t bytes_written = 0;
+  size_t iov_ofs = 0;
+  off_t size = 0;
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    size += iov[i].iov_len;
+
+  journal_begin ();
+  inode_lock (inode);
+  inode_grow_for_write (inode, offset, size);
+  while (offset < inode_length (inode))
+  {
+    int chunk_ofs = offset % CHUNK_SIZE;
+    off_t chunk_size = CHUNK_SIZE - chunk_ofs;
+
+    while (iov_cnt > 0 && iov_ofs == iov->iov_len)
+    {
+      iov++;
+      iov_cnt--;
+      iov_ofs = 0;
+    }
+    if (iov_cnt == 0 || !chunk_load (inode, offset / CHUNK_SIZE))
+      break;
+
+    if (chunk_size > inode_length (inode) - offset)
+      chunk_size = inode_length (inode) - offset;
+    if (chunk_size > (off_t) (iov->iov_len - iov_ofs))
+      chunk_size = iov->iov_len - iov_ofs;
+    memcpy (inode->chunk + chunk_ofs, (const uint8_t *) iov->iov_base + iov_ofs,
+            chunk_size);
+    inode->chunk_dirty = true;
+    offset += chunk_size;
+    bytes_written += chunk_size;
+    iov_ofs += chunk_size;
+  }
+  inode->read_length = inode_length (inode);
+  inode_unlock (inode);
+  journal_end ();
   return bytes_written;
 }
 
+/* Makes chunk IDX of compressed INODE its current chunk, storing
+   the previous one first if it changed.  A chunk whose sectors
+   are all allocated is stored as is; one with a hole after its
+   first N sectors is stored compressed in those N.  Sectors past
+   the inode's visible length have not been written yet, so they
+   are not read.  Returns false if memory is short or the stored
+   chunk is corrupt.  The caller must hold INODE's lock and be in
+   a journal operation. */
+static bool
+chunk_load (struct inode *inode, size_t idx)
+{
+  size_t first = idx * CHUNK_SECTORS;
+  size_t cnt = chunk_sectors (inode, idx);
+  size_t visible = bytes_to_data_sectors (inode->read_length);
+  size_t packed_cnt, i;
+
+  if (inode->chunk != NULL && inode->chunk_idx == idx)
+    return true;
+  if (inode->chunk == NULL)
+  {
+    inode->chunk = palloc_get_page (0);
+    if (inode->chunk == NULL)
+      return false;
+  }
+  else
+    chunk_flush (inode);
+  inode->chunk_idx = idx;
+  inode->chunk_dirty = false;
+  memset (inode->chunk, 0, CHUNK_SIZE);
+
+  for (packed_cnt = 0; packed_cnt < cnt; packed_cnt++)
+    if (get_slot (inode, first + packed_cnt) == 0)
+      break;
+  if (packed_cnt == 0)
+  {
+    /* Never written: reads as zeros. */
+  }
+  else if (packed_cnt == cnt)
+  {
+    for (i = 0; i < cnt && first + i < visible; i++)
+      cache_read (get_slot (inode, first + i),
+                  inode->chunk + i * BLOCK_SECTOR_SIZE);
+  }
+  else
+  {
+    uint8_t *packed = palloc_get_page (0);
+    struct chunk_header *h = (struct chunk_header *) packed;
+    bool ok;
+
+    if (packed == NULL)
+    {
+      palloc_free_page (inode->chunk);
+      inode->chunk = NULL;
+      return false;
+    }
+    for (i = 0; i < packed_cnt; i++)
+      cache_read (get_slot (inode, first + i),
+                  packed + i * BLOCK_SECTOR_SIZE);
+    ok = (h->packed_len <= packed_cnt * BLOCK_SECTOR_SIZE - sizeof *h
+          && h->data_len <= CHUNK_SIZE
+          && lz_decompress (h + 1, h->packed_len, inode->chunk,
+                            h->data_len) == h->data_len);
+    palloc_free_page (packed);
+    if (!ok)
+    {
+      palloc_free_page (inode->chunk);
+      inode->chunk = NULL;
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Stores compressed INODE's current chunk, if it changed.  It is
+   compressed, and kept that way if that saves at least a sector.
+   The sectors it needs are allocated and the rest are released,
+   leaving a hole that marks the chunk as compressed.  The caller
+   must hold INODE's lock and be in a journal operation. */
+static void
+chunk_flush (struct inode *inode)
+{
+  size_t first = inode->chunk_idx * CHUNK_SECTORS;
+  size_t cnt = chunk_sectors (inode, inode->chunk_idx);
+  const uint8_t *data = inode->chunk;
+  size_t used = cnt;
+  uint8_t *packed;
+  size_t i;
+
+  if (inode->chunk == NULL || !inode->chunk_dirty)
+    return;
+  inode->chunk_dirty = false;
+  if (cnt == 0)
+    return;
+
+  packed = palloc_get_page (PAL_ZERO);
+  if (packed != NULL && cnt > 1)
+  {
+    struct chunk_header *h = (struct chunk_header *) packed;
+    off_t data_len = inode_length (inode) - inode->chunk_idx * CHUNK_SIZE;
+    size_t packed_len;
+
+    if (data_len > CHUNK_SIZE)
+      data_len = CHUNK_SIZE;
+    packed_len = lz_compress (inode->chunk, data_len, h + 1,
+                              (cnt - 1) * BLOCK_SECTOR_SIZE - sizeof *h);
+    if (packed_len > 0)
+    {
+      h->packed_len = packed_len;
+      h->data_len = data_len;
+      used = DIV_ROUND_UP (sizeof *h + packed_len, BLOCK_SECTOR_SIZE);
+      data = packed;
+    }
+  }
+
+  for (i = 0; i < cnt; i++)
+  {
+    block_sector_t sector = get_slot (inode, first + i);
+    if (i < used)
+    {
+      if (sector == 0)
+      {
+        if (!free_map_allocate (1, &sector))
+          break;
+        set_slot (inode, first + i, sector);
+      }
+      cache_write (sector, data + i * BLOCK_SECTOR_SIZE, inode->sector);
+    }
+    else if (sector != 0)
+    {
+      set_slot (inode, first + i, 0);
+      free_map_release (sector, 1);
+    }
+  }
+  if (packed != NULL)
+    palloc_free_page (packed);
+}
+
+/* Stores compressed INODE's current chunk, if it changed, for a
+   caller that holds neither its lock nor a journal operation. */
+static void
+chunk_sync (struct inode *inode)
+{
+  journal_begin ();
+  inode_lock (inode);
+  chunk_flush (inode);
+  inode_unlock (inode);
+  journal_end ();
+}
+
+/* Gets compressed INODE's chunks ready for it to shrink to
+   LENGTH bytes.  The current chunk is dropped if it lies wholly
+   past LENGTH.  The chunk that LENGTH falls in is loaded, with
+   everything past LENGTH zeroed, so that chunk_flush() can store
+   it again once the sectors past LENGTH are released.  The
+   caller must hold INODE's lock and be in a journal operation. */
+static void
+chunk_cut (struct inode *inode, off_t length)
+{
+  if (inode->chunk != NULL
+      && inode->chunk_idx >= (size_t) DIV_ROUND_UP (length, CHUNK_SIZE))
+  {
+    palloc_free_page (inode->chunk);
+    inode->chunk = NULL;
+  }
+  if (length % CHUNK_SIZE != 0 && chunk_load (inode, length / CHUNK_SIZE))
+  {
+    memset (inode->chunk + length % CHUNK_SIZE, 0,
+            CHUNK_SIZE - length % CHUNK_SIZE);
+    inode->chunk_dirty = true;
+  }
+}
+
+/* Transfers CNT whole sectors between BOUNCE and INODE, whose
+   length is LENGTH, starting at byte OFFSET, which must be a
+   multiple of BLOCK_SECTOR_SIZE.  Reads if WRITE is false,
+   writes if it is true.  Runs of consecutive sectors are passed
+   to the cache together. */
+static void
+inode_transfer_direct (struct inode *inode, off_t length, uint8_t *bounce,
+                       size_t cnt, off_t offset, bool write)
+{
+  ASSERT (offset % BLOCK_SECTOR_SIZE == 0);
+
+  while (cnt > 0)
+  {
+    block_sector_t start = byte_to_sector (inode, length, offset);
+    size_t run = 1;
+
+    while (run < cnt
+           && (byte_to_sector (inode, length,
+                               offset + run * BLOCK_SECTOR_SIZE)
+               == start + run))
+      run++;
+    if (write)
+      cache_write_direct (start, run, bounce);
+    else
+      cache_read_direct (start, run, bounce);
+
+    bounce += run * BLOCK_SECTOR_SIZE;
+    offset += run * BLOCK_SECTOR_SIZE;
+    cnt -= run;
+  }
+}
+
+/* Extends INODE, if it is too short, to hold SIZE bytes written
+   at OFFSET, or as far toward that as free space allows.  New
+   sectors that the write covers completely are about to be
+   overwritten, so they are not zeroed first; the caller must
+   write them before letting readers see the new length. */
+static void
+inode_grow_for_write (struct inode *inode, off_t offset, off_t size)
+{
+  off_t first = ROUND_UP (offset, BLOCK_SECTOR_SIZE);
+  off_t last = ROUND_DOWN (offset + size, BLOCK_SECTOR_SIZE);
+
+  if (offset + size <= inode_length (inode))
+    return;
+  if (last > first)
+  {
+    bool zero_fill = inode->zero_fill;
+    inode_extend (inode, first);
+    inode->zero_fill = false;
+    inode_extend (inode, last);
+    inode->zero_fill = zero_fill;
+  }
+  inode_extend (inode, offset + size);
+  inode_flush (inode);
+}
+
+/* Extends INODE to NEW_LENGTH bytes if it is shorter, or as far
+   toward it as free space allows. */
+static void
+inode_extend (struct inode *inode, off_t new_length)
+{
+  if (new_length > inode_length (inode))
+    inode->data.length = inode_expand (inode, new_length);
+}
+
+/* Sets INODE's length to LENGTH bytes.  Growing the file fills
+   it with zeros, as far as free space allows.  Shrinking it
+   releases every sector past the new end, including any reserved
+   by inode_allocate().  Returns true if INODE is now LENGTH bytes
+   long. */
+bool
+inode_truncate (struct inode *inode, off_t length)
+{
+  ASSERT (length >= 0);
+
+  if (inode->deny_write_cnt || length > INODE_MAX_LENGTH)
+    return false;
+  if (inode->mem != NULL)
+  {
+    tmpfs_truncate (inode->mem, length);
+    inode->data.length = length;
+    inode_flush (inode);
+    inode->read_length = length;
+    return true;
+  }
+
+  journal_begin ();
+  if (inode->data.compressed)
+    inode_lock (inode);
+  if (length > inode_length (inode))
+    inode_extend (inode, length);
+  else
+  {
+    if (inode->data.compressed)
+      chunk_cut (inode, length);
+    inode_shrink (inode, length);
+  }
+  inode_flush (inode);
+  inode->read_length = inode_length (inode);
+  if (inode->data.compressed)
+  {
+    chunk_flush (inode);
+    inode_unlock (inode);
+  }
+  journal_end ();
+  return inode_length (inode) == length;
+}
+
+/* Reserves the sectors INODE needs to hold LEN bytes at OFFSET,
+   without changing its length, so that later writes there do not
+   have to allocate.  The sectors are taken as one run if a long
+   enough one is free, and they are not zeroed now; a write that
+   extends the file over them zeroes whatever it does not cover.
+   Returns true if successful.  Returns false, reserving nothing,
+   if INODE may not be written, the range is too long, or the
+   disk does not have enough free sectors. */
+bool
+inode_allocate (struct inode *inode, off_t offset, off_t len)
+{
+  off_t end = offset + len;
+  size_t cnt, old_cnt;
+  bool zero_fill, success;
+
+  ASSERT (offset >= 0 && len >= 0);
+
+  if (inode->deny_write_cnt || end > INODE_MAX_LENGTH)
+    return false;
+  if (inode->mem != NULL)
+    return tmpfs_reserve (inode->mem, offset, len);
+  old_cnt = allocated_sectors (inode);
+  cnt = bytes_to_data_sectors (end);
+  if (cnt <= old_cnt)
+    return true;
+  cnt -= old_cnt;
+
+  journal_begin ();
+  if (free_map_allocate (cnt, &inode->run_start))
+    inode->run_left = cnt;
+  zero_fill = inode->zero_fill;
+  inode->zero_fill = false;
+  success = inode_expand (inode, end) == end;
+  inode->zero_fill = zero_fill;
+  if (inode->run_left > 0)
+  {
+    free_map_release (inode->run_start, inode->run_left);
+    inode->run_left = 0;
+  }
+  if (!success)
+  {
+    /* Give back what we did get.  OLD_CNT sectors always cover
+       the current length, so shrinking to them leaves the data
+       alone. */
+    off_t length = inode->data.length;
+    off_t read_length = inode->read_length;
+    inode_shrink (inode, (off_t) old_cnt * BLOCK_SECTOR_SIZE);
+    inode->data.length = length;
+    inode->read_length = read_length;
+  }
+  inode_flush (inode);
+  journal_end ();
+  return success;
+}
+
+/* Adds SECTOR to the run of sectors to release that starts at
+   *STARTP and is *CNTP long, releasing that run first if SECTOR
+   does not continue it. */
+static void
+release_sector (block_sector_t sector, block_sector_t *startp, size_t *cntp)
+{
+  if (*cntp > 0 && sector == *startp + *cntp)
+  {
+    (*cntp)++;
+    return;
+  }
+  if (*cntp > 0)
+    free_map_release (*startp, *cntp);
+  *startp = sector;
+  *cntp = 1;
+}
+
+/* Shrinks INODE to NEW_LENGTH bytes and releases its sectors past
+   the new end.  Consecutive data sectors go back to the free map
+   as one run.  The rest of the last sector is zeroed, so that
+   growing the file again reads back zeros. */
+static void
+inode_shrink (struct inode *inode, off_t new_length)
+{
+  size_t old_cnt = allocated_sectors (inode);
+  size_t new_cnt = bytes_to_data_sectors (new_length);
+  struct indir_block outer, inner;
+  block_sector_t run_start = 0;
+  size_t run_cnt = 0;
+  size_t i;
+
+  inode->read_length = new_length;
+  if (new_length % BLOCK_SECTOR_SIZE != 0 && !inode->data.compressed)
+  {
+    int sector_ofs = new_length % BLOCK_SECTOR_SIZE;
+    struct cache_entry *c = check_cache (byte_to_sector (inode,
+                                                         inode_length (inode),
+                                                         new_length - 1),
+                                         true);
+    memset ((uint8_t *) &c->block + sector_ofs, 0,
+            BLOCK_SECTOR_SIZE - sector_ofs);
+    c->accessed = true;
+    c->owner = inode->sector;
+    c->open_cnt--;
+  }
+  inode->data.length = new_length;
+  if (new_cnt >= old_cnt)
+    return;
+
+  /* Data sectors. */
+  for (i = new_cnt; i < old_cnt; i++)
+  {
+    block_sector_t sector;
+    if (i < 8)
+      sector = inode->data.ptr[i];
+    else if (i < 8 + 128)
+    {
+      if (i == new_cnt || i == 8)
+        cache_read (inode->data.ptr[8], &inner);
+      sector = inner.ptr[i - 8];
+    }
+    else
+    {
+      size_t k = (i - 8 - 128) % 128;
+      if (i == new_cnt || i == 8 + 128)
+        cache_read (inode->data.ptr[9], &outer);
+      if (i == new_cnt || k == 0)
+        cache_read (outer.ptr[(i - 8 - 128) / 128], &inner);
+      sector = inner.ptr[k];
+    }
+    if (sector != 0)
+      release_sector (sector, &run_start, &run_cnt);
+  }
+  if (run_cnt > 0)
+    free_map_release (run_start, run_cnt);
+
+  /* Indirect blocks that no longer point to anything. */
+  if (new_cnt <= 8 && old_cnt > 8)
+    free_map_release (inode->data.ptr[8], 1);
+  if (old_cnt > 8 + 128)
+  {
+    size_t first = 0;
+    if (new_cnt > 8 + 128)
+      first = DIV_ROUND_UP (new_cnt - 8 - 128, 128);
+    size_t last = (old_cnt - 8 - 128 - 1) / 128;
+    for (i = first; i <= last; i++)
+      free_map_release (outer.ptr[i], 1);
+    if (new_cnt <= 8 + 128)
+      free_map_release (inode->data.ptr[9], 1);
+  }
+
+  /* Where inode_expand() will continue growing the inode. */
+  if (new_cnt <= 8)
+  {
+    inode->data.i_dir = new_cnt;
+    inode->data.i_indir = 0;
+    inode->data.i_doubly = 0;
+  }
+  else if (new_cnt < 8 + 128)
+  {
+    inode->data.i_dir = 8;
+    inode->data.i_indir = new_cnt - 8;
+    inode->data.i_doubly = 0;
+  }
+  else
+  {
+    inode->data.i_dir = 9;
+    inode->data.i_indir = (new_cnt - 8 - 128) / 128;
+    inode->data.i_doubly = (new_cnt - 8 - 128) % 128;
+  }
+}
+
+/* Writes CNT whole sectors from BUFFER into INODE, starting at
+   OFFSET, which must be a multiple of BLOCK_SECTOR_SIZE.  The
+   sectors go straight to disk instead of through the buffer
+   cache, and any cached copies are discarded.  INODE must
+   already be long enough to hold the data, except that the last
+   sector may extend past end of file.  This is meant for loading
+   a file created by inode_create_contiguous() in bulk, so each
+   run of consecutive sectors is written with one request. */
+void
+inode_write_sectors (struct inode *inode, const void *buffer_, size_t cnt,
+                     off_t offset)
+{
+  const uint8_t *buffer = buffer_;
+  size_t i, j, run;
+
+  ASSERT (offset % BLOCK_SECTOR_SIZE == 0);
+  ASSERT (cnt == 0 || (offset + (off_t) (cnt - 1) * BLOCK_SECTOR_SIZE
+                       < inode_length (inode)));
+
+  ASSERT (!inode->data.compressed);
+
+  if (inode->mem != NULL)
+    {
+      off_t size = cnt * BLOCK_SECTOR_SIZE;
+      if (size > inode_length (inode) - offset)
+        size = inode_length (inode) - offset;
+      tmpfs_write (inode->mem, buffer, size, offset);
+      return;
+    }
+
+  for (i = 0; i < cnt; i += run)
+    {
+      off_t pos = offset + i * BLOCK_SECTOR_SIZE;
+      block_sector_t sector = byte_to_sector (inode, inode_length (inode),
+                                              pos);
+      for (run = 1; i + run < cnt; run++)
+        if (byte_to_sector (inode, inode_length (inode),
+                            pos + run * BLOCK_SECTOR_SIZE) != sector + run)
+          break;
+      for (j = 0; j < run; j++)
+        cache_invalidate (sector + j);
+      block_write_multiple (fs_device, sector, run,
+                            buffer + i * BLOCK_SECTOR_SIZE);
+    }
+}
+
+/* Writes INODE's dirty data to disk, in sector order, without
+   flushing the rest of the buffer cache.  Then makes its metadata
+   durable too, unless DATA_ONLY is true and INODE's length and
+   block map have not changed since it was last synced.  A tmpfs
+   inode has nothing to write. */
+void
+inode_sync (struct inode *inode, bool data_only)
+{
+  if (inode->mem != NULL)
+    return;
+  if (inode->chunk != NULL)
+    chunk_sync (inode);
+  cache_sync (inode->sector);
+  if (!data_only || inode->meta_dirty)
+  {
+    inode->meta_dirty = false;
+    journal_sync ();
+  }
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
   void
@@ -422,14 +1675,16 @@ inode_length (struct inode *inode)
 
 void inode_dealloc (struct inode *inode)
 {
-  size_t data_sectors = bytes_to_data_sectors(inode->data.length);
-  size_t indirect_sectors = bytes_to_indirect_sectors(inode->data.length);
+  off_t alloc_length = allocated_sectors(inode) * BLOCK_SECTOR_SIZE;
+  size_t data_sectors = bytes_to_data_sectors(alloc_length);
+  size_t indirect_sectors = bytes_to_indirect_sectors(alloc_length);
   size_t double_indirect_sector = bytes_to_double_indirect_sector(
-      inode->data.length);
+      alloc_length);
   unsigned int idx = 0;
   while (data_sectors && idx < 8)
   {
-    free_map_release (inode->data.ptr[idx], 1);
+    if (inode->data.ptr[idx] != 0)
+      free_map_release (inode->data.ptr[idx], 1);
     data_sectors--;
     idx++;
   }
@@ -456,7 +1711,7 @@ void inode_dealloc_double_indirect_block (block_sector_t *ptr,
 {
   unsigned int i;
   struct indir_block block;
-  block_read(fs_device, *ptr, &block);
+  cache_read(*ptr, &block);
   for (i = 0; i < indirect_ptrs; i++)
   {
     size_t data_per_block = data_ptrs < 128 ? data_ptrs : \
@@ -472,29 +1727,66 @@ void inode_dealloc_indirect_block (block_sector_t *ptr,
 {
   unsigned int i;
   struct indir_block block;
-  block_read(fs_device, *ptr, &block);
+  cache_read(*ptr, &block);
   for (i = 0; i < data_ptrs; i++)
   {
-    free_map_release(block.ptr[i], 1);
+    if (block.ptr[i] != 0)
+      free_map_release(block.ptr[i], 1);
   }
   free_map_release(*ptr, 1);
 }
 
-off_t inode_expand (struct inode *inode, off_t new_length)
+/* Allocates a data sector for INODE and stores it in *SECTORP.
+   Takes the sector from INODE's preallocated run while it lasts,
+   otherwise from the free map.  Zeroes the sector unless INODE's
+   data is about to be overwritten.  Returns false, leaving
+   *SECTORP unchanged, if the disk is full. */
+static bool
+allocate_data_sector (struct inode *inode, block_sector_t *sectorp)
 {
   static char zeros[BLOCK_SECTOR_SIZE];
-  size_t new_data_sectors = bytes_to_data_sectors(new_length) - \
-			    bytes_to_data_sectors(inode->data.length);
 
-  if (new_data_sectors == 0)
+  if (inode->run_left > 0)
+  {
+    *sectorp = inode->run_start++;
+    inode->run_left--;
+  }
+  else if (!free_map_allocate (1, sectorp))
+    return false;
+  if (inode->zero_fill)
+    cache_write(*sectorp, zeros, inode->sector);
+  return true;
+}
+
+off_t inode_expand (struct inode *inode, off_t new_length)
+{
+  size_t old_sectors = bytes_to_data_sectors(inode->data.length);
+  size_t reserved = allocated_sectors(inode);
+  size_t wanted = bytes_to_data_sectors(new_length);
+  size_t new_data_sectors;
+
+  /* Sectors reserved past end of file are used up first.  They
+     were not zeroed when they were reserved. */
+  if (inode->zero_fill)
+  {
+    static char zeros[BLOCK_SECTOR_SIZE];
+    size_t i;
+
+    for (i = old_sectors; i < reserved && i < wanted; i++)
+      cache_write(byte_to_sector(inode, reserved * BLOCK_SECTOR_SIZE,
+                                 i * BLOCK_SECTOR_SIZE),
+                  zeros, inode->sector);
+  }
+  if (wanted <= reserved)
   {
     return new_length;
   }
+  new_data_sectors = wanted - reserved;
 
   while (inode->data.i_dir < 8)
   {
-    free_map_allocate (1, &inode->data.ptr[inode->data.i_dir]);
-    block_write(fs_device, inode->data.ptr[inode->data.i_dir], zeros);
+    if (!allocate_data_sector (inode, &inode->data.ptr[inode->data.i_dir]))
+      return new_length - new_data_sectors*BLOCK_SECTOR_SIZE;
     inode->data.i_dir++;
     new_data_sectors--;
     if (new_data_sectors == 0)
@@ -504,11 +1796,17 @@ off_t inode_expand (struct inode *inode, off_t new_length)
   }
   while (inode->data.i_dir < 9)
   {
-    new_data_sectors = inode_expand_indirect_block(inode, new_data_sectors);
-    if (new_data_sectors == 0)
+    size_t left = inode_expand_indirect_block(inode, new_data_sectors);
+    if (left == 0)
     {
       return new_length;
     }
+    if (inode->data.i_dir < 9)
+    {
+      /* The disk is full. */
+      return new_length - left*BLOCK_SECTOR_SIZE;
+    }
+    new_data_sectors = left;
   }
   if (inode->data.i_dir == 9)
   {
@@ -522,24 +1820,33 @@ size_t inode_expand_double_indirect_block (struct inode *inode,
     size_t new_data_sectors)
 {
   struct indir_block block;
-  if (inode->data.i_doubly == 0 && inode->data.i_indir == 0)
+  size_t old_cnt = allocated_sectors(inode);
+  bool fresh = inode->data.i_doubly == 0 && inode->data.i_indir == 0;
+  if (fresh)
   {
-    free_map_allocate(1, &inode->data.ptr[inode->data.i_dir]);
+    if (!free_map_allocate(1, &inode->data.ptr[inode->data.i_dir]))
+      return new_data_sectors;
   }
   else
   {
-    block_read(fs_device, inode->data.ptr[inode->data.i_dir], &block);
+    cache_read(inode->data.ptr[inode->data.i_dir], &block);
   }
   while (inode->data.i_indir < 128)
   {
-    new_data_sectors = inode_expand_double_indirect_block_lvl_two(inode,
+    size_t left = inode_expand_double_indirect_block_lvl_two(inode,
 	new_data_sectors, &block);
-    if (new_data_sectors == 0)
+    bool stuck = left == new_data_sectors
+                 || (left > 0 && inode->data.i_doubly != 0);
+    new_data_sectors = left;
+    if (new_data_sectors == 0 || stuck)
     {
       break;
     }
   }
-  block_write(fs_device, inode->data.ptr[inode->data.i_dir], &block);
+  if (fresh && allocated_sectors(inode) == old_cnt)
+    free_map_release(inode->data.ptr[inode->data.i_dir], 1);
+  else
+    journal_write(inode->data.ptr[inode->data.i_dir], &block);
   return new_data_sectors;
 }
 
@@ -547,22 +1854,29 @@ size_t inode_expand_double_indirect_block_lvl_two (struct inode *inode,
     size_t new_data_sectors,
     struct indir_block* outer_block)
 {
-  static char zeros[BLOCK_SECTOR_SIZE];
   struct indir_block inner_block;
-  if (inode->data.i_doubly == 0)
+  bool fresh = inode->data.i_doubly == 0;
+  if (fresh)
   {
-    free_map_allocate(1, &outer_block->ptr[inode->data.i_indir]);
+    if (!free_map_allocate(1, &outer_block->ptr[inode->data.i_indir]))
+      return new_data_sectors;
   }
   else
   {
-    block_read(fs_device, outer_block->ptr[inode->data.i_indir],
-	&inner_block);
+    cache_read(outer_block->ptr[inode->data.i_indir], &inner_block);
   }
   while (inode->data.i_doubly < 128)
   {
-    free_map_allocate(1, &inner_block.ptr[inode->data.i_doubly]);
-    block_write(fs_device, inner_block.ptr[inode->data.i_doubly],
-	zeros);
+    if (!allocate_data_sector (inode,
+                               &inner_block.ptr[inode->data.i_doubly]))
+    {
+      /* The disk is full. */
+      if (fresh && inode->data.i_doubly == 0)
+        free_map_release(outer_block->ptr[inode->data.i_indir], 1);
+      else
+        journal_write(outer_block->ptr[inode->data.i_indir], &inner_block);
+      return new_data_sectors;
+    }
     inode->data.i_doubly++;
     new_data_sectors--;
     if (new_data_sectors == 0)
@@ -570,7 +1884,7 @@ size_t inode_expand_double_indirect_block_lvl_two (struct inode *inode,
       break;
     }
   }
-  block_write(fs_device, outer_block->ptr[inode->data.i_indir], &inner_block);
+  journal_write(outer_block->ptr[inode->data.i_indir], &inner_block);
   if (inode->data.i_doubly == 128)
   {
     inode->data.i_doubly = 0;
@@ -582,20 +1896,28 @@ size_t inode_expand_double_indirect_block_lvl_two (struct inode *inode,
 size_t inode_expand_indirect_block (struct inode *inode,
     size_t new_data_sectors)
 {
-  static char zeros[BLOCK_SECTOR_SIZE];
   struct indir_block block;
-  if (inode->data.i_indir == 0)
+  bool fresh = inode->data.i_indir == 0;
+  if (fresh)
   {
-    free_map_allocate(1, &inode->data.ptr[inode->data.i_dir]);
+    if (!free_map_allocate(1, &inode->data.ptr[inode->data.i_dir]))
+      return new_data_sectors;
   }
   else
   {
-    block_read(fs_device, inode->data.ptr[inode->data.i_dir], &block);
+    cache_read(inode->data.ptr[inode->data.i_dir], &block);
   }
   while (inode->data.i_indir < 128)
   {
-    free_map_allocate(1, &block.ptr[inode->data.i_indir]);
-    block_write(fs_device, block.ptr[inode->data.i_indir], zeros);
+    if (!allocate_data_sector (inode, &block.ptr[inode->data.i_indir]))
+    {
+      /* The disk is full. */
+      if (fresh && inode->data.i_indir == 0)
+        free_map_release(inode->data.ptr[inode->data.i_dir], 1);
+      else
+        journal_write(inode->data.ptr[inode->data.i_dir], &block);
+      return new_data_sectors;
+    }
     inode->data.i_indir++;
     new_data_sectors--;
     if (new_data_sectors == 0)
@@ -603,7 +1925,7 @@ size_t inode_expand_indirect_block (struct inode *inode,
       break;
     }
   }
-  block_write(fs_device, inode->data.ptr[inode->data.i_dir], &block);
+  journal_write(inode->data.ptr[inode->data.i_dir], &block);
   if (inode->data.i_indir == 128)
   {
     inode->data.i_indir = 0;
@@ -612,19 +1934,49 @@ size_t inode_expand_indirect_block (struct inode *inode,
   return new_data_sectors;
 }
 
-bool inode_alloc (struct inode_disk *disk_inode)
+/* Allocates the data sectors for DISK_INODE, the new inode to be
+   written to SECTOR.  The sectors are zeroed through the cache on
+   behalf of SECTOR, so that syncing the inode also syncs them,
+   unless CONTIGUOUS, in which case they are taken as one run if
+   possible and left as they are. */
+bool inode_alloc (struct inode_disk *disk_inode, block_sector_t sector,
+                  bool contiguous)
 {
   struct inode *inode = malloc(sizeof *inode);
+  if (inode == NULL)
+    return false;
+  inode->sector = sector;
   inode->data.length = 0;
   inode->data.i_dir = 0;
   inode->data.i_indir = 0;
   inode->data.i_doubly = 0;  
+  inode->run_left = 0;
+  inode->zero_fill = !contiguous;
+
+  /* Take all the data sectors as one run if possible.  Indirect
+     blocks still come from the free map, outside the run. */
+  if (contiguous)
+  {
+    size_t data_sectors = bytes_to_data_sectors(disk_inode->length);
+    if (data_sectors > 0
+        && free_map_allocate (data_sectors, &inode->run_start))
+      inode->run_left = data_sectors;
+  }
 
-  inode_expand(inode, disk_inode->length);
+  if (inode_expand(inode, disk_inode->length) < disk_inode->length)
+  {
+    /* The disk is full. */
+    if (inode->run_left > 0)
+      free_map_release (inode->run_start, inode->run_left);
+    inode_dealloc (inode);
+    free (inode);
+    return false;
+  }
   disk_inode->i_dir = inode->data.i_dir;
   disk_inode->i_indir = inode->data.i_indir;
   disk_inode->i_doubly = inode->data.i_doubly;
   memcpy(&disk_inode->ptr, &inode->data.ptr, 10*sizeof(block_sector_t));
+  free(inode);
   return true;
 }
 
@@ -652,5 +2004,37 @@ bool inode_add_parent (block_sector_t parent_sector,
     return false;
   }
   inode->data.parent = parent_sector;
+  journal_begin ();
+  inode_flush (inode);
+  journal_end ();
+  inode_close (inode);
   return true;
 }
+
+/* Writes INODE's in-memory copy of its on-disk inode back to
+   its sector, through the journal, or to its tmpfs node. */
+static void
+inode_flush (struct inode *inode)
+{
+  struct inode_disk disk_inode;
+
+  if (inode->mem != NULL)
+  {
+    inode->mem->length = inode->data.length;
+    inode->mem->parent = inode->data.parent;
+    return;
+  }
+
+  memset (&disk_inode, 0, sizeof disk_inode);
+  disk_inode.parent = inode->data.parent;
+  disk_inode.length = inode->data.length;
+  disk_inode.magic = INODE_MAGIC;
+  memcpy (&disk_inode.ptr, &inode->data.ptr, 10*sizeof(block_sector_t));
+  disk_inode.isdir = inode->data.isdir;
+  disk_inode.i_dir = inode->data.i_dir;
+  disk_inode.i_indir = inode->data.i_indir;
+  disk_inode.i_doubly = inode->data.i_doubly;
+  disk_inode.compressed = inode->data.compressed;
+  journal_write (inode->sector, &disk_inode);
+  inode->meta_dirty = true;
+}
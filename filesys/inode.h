@@ -2,6 +2,7 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <uio.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
@@ -9,6 +10,7 @@ struct bitmap;
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, bool);
+bool inode_create_contiguous (block_sector_t, off_t);
 struct inode *inode_is_open (block_sector_t);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
@@ -16,8 +18,26 @@ block_sector_t inode_get_inumber (const struct inode *);
 bool inode_is_dir (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+bool inode_is_removed (const struct inode *);
+void inode_lock (struct inode *);
+void inode_unlock (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_read_iov (struct inode *, const struct iovec *, size_t iov_cnt,
+                      off_t offset);
+off_t inode_write_iov (struct inode *, const struct iovec *, size_t iov_cnt,
+                       off_t offset);
+off_t inode_read_direct (struct inode *, void *, off_t size, off_t offset);
+off_t inode_write_direct (struct inode *, const void *, off_t size,
+                          off_t offset);
+off_t inode_copy (struct inode *dst, off_t dst_ofs, struct inode *src,
+                  off_t src_ofs, off_t size);
+void inode_write_sectors (struct inode *, const void *, size_t cnt,
+                          off_t offset);
+void inode_sync (struct inode *, bool data_only);
+bool inode_truncate (struct inode *, off_t length);
+bool inode_allocate (struct inode *, off_t offset, off_t len);
+bool inode_set_compressed (struct inode *);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (struct inode *);
@@ -0,0 +1,845 @@
+#include "filesys/journal.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* The journal is a write-ahead log of metadata sectors: inodes,
+   indirect blocks, directory contents and the free map.
+
+   An operation that changes metadata brackets its changes with
+   journal_begin() and journal_end().  Each metadata sector it
+   writes goes into the buffer cache as usual, and an image of
+   the new contents is recorded in the running transaction.  The
+   running transaction collects the changes of any number of
+   operations, and is committed, at a moment when no operation is
+   in progress, by writing its images sequentially into the log
+   region followed by a commit block.  That happens when it grows
+   large, when the write-back thread asks for it, and at
+   shutdown.  Once it has grown large, new operations wait for
+   the commit instead of joining it, so that it cannot outgrow
+   the log.
+
+   A commit or checkpoint has exclusive use of the log: it sets
+   commit_wanted, which holds off new operations, and waits for
+   those in progress to end.  Nothing but it can then change the
+   lists of images, so it writes to disk without holding
+   journal_lock, and the buffer cache can keep calling
+   journal_read() and journal_holds() meanwhile.
+
+   Until a committed image has been checkpointed, that is, copied
+   to its home sector, the buffer cache must not write the sector
+   home itself, or a crash could leave half of an operation on
+   disk.  The cache asks journal_holds() before writing a sector
+   and drops such a sector without writing it when evicting, and
+   refills it with journal_read() on the next miss.  The write-back
+   thread checkpoints lazily, once the log is half full.
+
+   A sector freed by the running transaction is not reused until
+   the transaction commits.  Otherwise it could be overwritten
+   while a crash would still roll back the free and leave it in
+   use by its old owner.
+
+   After an unclean shutdown, journal_init() replays every
+   committed transaction in the log, so the metadata is
+   consistent without scanning the file system.
+
+   File data is not journaled. */
+
+/* Identifies the journal header, a descriptor block and a
+   commit block. */
+#define JOURNAL_MAGIC 0x4a524e4c
+#define DESC_MAGIC 0x4a444553
+#define COMMIT_MAGIC 0x4a434d54
+
+/* Number of sectors listed in a descriptor block. */
+#define DESC_ENTRIES 124
+
+/* A running transaction that has logged at least this many
+   sectors is committed as soon as no operation is in progress. */
+#define COMMIT_SECTORS 64
+
+/* Log sectors taken by a transaction of COMMIT_SECTORS images:
+   its descriptor blocks, the images, and the commit block. */
+#define COMMIT_LOG_SECTORS \
+  (DIV_ROUND_UP (COMMIT_SECTORS, DESC_ENTRIES) + COMMIT_SECTORS + 1)
+
+/* Limits on the number of sectors in the log region.  Even the
+   smallest log holds two full-size transactions, leaving room
+   for what operations already in progress add to a transaction
+   that has reached COMMIT_SECTORS. */
+#define JOURNAL_MIN_SECTORS (2 * COMMIT_LOG_SECTORS)
+#define JOURNAL_MAX_SECTORS 1024
+
+/* On-disk journal header, in JOURNAL_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;             /* JOURNAL_MAGIC. */
+    block_sector_t start;       /* First sector of log region. */
+    uint32_t size;              /* Number of sectors in log region. */
+    uint32_t tail;              /* Log position of oldest transaction. */
+    uint32_t seq;               /* Sequence number of that transaction. */
+    uint32_t unused[123];       /* Not used. */
+  };
+
+/* A descriptor or commit block in the log.  A transaction is one
+   or more descriptor blocks, each followed by the images of the
+   sectors it lists, and then a commit block.  A sector listed as
+   revoked was freed during the transaction, so images of it in
+   this or earlier transactions must not be replayed.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_desc
+  {
+    unsigned magic;             /* DESC_MAGIC or COMMIT_MAGIC. */
+    uint32_t seq;               /* Transaction sequence number. */
+    uint32_t block_cnt;         /* Number of images that follow. */
+    uint32_t revoke_cnt;        /* Number of revoked sectors. */
+    block_sector_t sectors[DESC_ENTRIES]; /* Imaged, then revoked. */
+  };
+
+/* In-memory images of a metadata sector that the cache may not
+   write home.  Exists only while at least one image does. */
+struct jblock
+  {
+    struct hash_elem hash_elem;         /* Element in jblocks. */
+    struct list_elem run_elem;          /* Element in running_list. */
+    struct list_elem commit_elem;       /* Element in committed_list. */
+    block_sector_t sector;              /* Home sector. */
+    uint8_t *running;                   /* Image in running transaction. */
+    uint8_t *committed;                 /* Image not yet checkpointed. */
+  };
+
+/* A revoked sector found during recovery. */
+struct revocation
+  {
+    block_sector_t sector;              /* Revoked sector. */
+    uint32_t seq;                       /* Latest revoking transaction. */
+  };
+
+static bool enabled;                    /* False if disk has no journal. */
+static struct journal_header header;    /* Copy of on-disk header. */
+static uint32_t head;                   /* Log position for next record. */
+static uint32_t used;                   /* Sectors in use in the log. */
+static uint32_t running_seq;            /* Running transaction's number. */
+
+static struct hash jblocks;             /* All jblocks, by sector. */
+static struct list running_list;        /* jblocks with running images. */
+static size_t running_cnt;              /* Length of running_list. */
+static struct list committed_list;      /* jblocks with committed images. */
+static block_sector_t *revokes;         /* Revoked in running transaction. */
+static size_t revoke_cnt, revoke_cap;   /* Length and capacity of revokes. */
+static struct bitmap *freed;            /* Freed in running transaction. */
+
+static struct lock journal_lock;        /* Protects everything above. */
+static struct condition journal_cond;   /* Signaled on changes below. */
+static int active_cnt;                  /* Operations in progress. */
+static bool commit_wanted;              /* A commit or checkpoint holds
+                                           or awaits the log. */
+
+static struct jblock *jblock_find (block_sector_t);
+static hash_hash_func jblock_hash;
+static hash_less_func jblock_less;
+static list_less_func jblock_sector_less;
+static void begin_exclusive (void);
+static void end_exclusive (void);
+static void commit_exclusive (void);
+static void commit_running (void);
+static void write_through (void);
+static void checkpoint (bool exclusive);
+static void log_write (const void *);
+static void recover (void);
+static bool scan_transaction (uint32_t *posp, uint32_t seq,
+                              struct revocation **, size_t *cnt,
+                              size_t *cap);
+static void replay_transaction (uint32_t *posp, uint32_t seq,
+                                const struct revocation *, size_t cnt);
+
+/* Reserves the log region on a newly formatted file system and
+   writes the journal header. */
+void
+journal_create (void)
+{
+  size_t size = block_size (fs_device) / 16;
+
+  ASSERT (sizeof header == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_desc) == BLOCK_SECTOR_SIZE);
+
+  if (size < JOURNAL_MIN_SECTORS)
+    size = JOURNAL_MIN_SECTORS;
+  if (size > JOURNAL_MAX_SECTORS)
+    size = JOURNAL_MAX_SECTORS;
+
+  memset (&header, 0, sizeof header);
+  if (!free_map_allocate (size, &header.start))
+    PANIC ("journal creation failed");
+  header.magic = JOURNAL_MAGIC;
+  header.size = size;
+  header.tail = 0;
+  header.seq = 1;
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+}
+
+/* Initializes the journal module and replays any transactions
+   committed to the log but not yet checkpointed.  Must be called
+   before the free map is opened.  A
+   file system without a journal header is used without
+   journaling. */
+void
+journal_init (void)
+{
+  hash_init (&jblocks, jblock_hash, jblock_less, NULL);
+  list_init (&running_list);
+  list_init (&committed_list);
+  lock_init (&journal_lock);
+  cond_init (&journal_cond);
+
+  block_read (fs_device, JOURNAL_SECTOR, &header);
+  if (header.magic != JOURNAL_MAGIC || header.size == 0)
+    {
+      printf ("filesys: no journal, metadata is not journaled\n");
+      return;
+    }
+
+  freed = bitmap_create (block_size (fs_device));
+  if (freed == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+
+  recover ();
+  enabled = true;
+}
+
+/* Starts a metadata operation.  The operation's changes are
+   committed together, in the same transaction.  Calls nest, so
+   an operation may be made of smaller ones. */
+void
+journal_begin (void)
+{
+  if (!enabled || thread_current ()->journal_depth++ > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  for (;;)
+    {
+      if (commit_wanted)
+        cond_wait (&journal_cond, &journal_lock);
+      else if (running_cnt >= COMMIT_SECTORS)
+        commit_exclusive ();
+      else
+        break;
+    }
+  active_cnt++;
+  lock_release (&journal_lock);
+}
+
+/* Ends the operation started by the matching journal_begin(). */
+void
+journal_end (void)
+{
+  if (!enabled)
+    return;
+  ASSERT (thread_current ()->journal_depth > 0);
+  if (--thread_current ()->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  if (--active_cnt == 0)
+    {
+      if (running_cnt >= COMMIT_SECTORS && !commit_wanted)
+        commit_exclusive ();
+      cond_broadcast (&journal_cond, &journal_lock);
+    }
+  lock_release (&journal_lock);
+}
+
+/* Writes DATA, a full sector of metadata, to SECTOR through the
+   buffer cache and records it in the running transaction. */
+void
+journal_write (block_sector_t sector, const void *data)
+{
+  struct cache_entry *c = check_cache (sector, true);
+  memcpy (c->block, data, BLOCK_SECTOR_SIZE);
+  c->accessed = true;
+  c->dirty = true;
+  journal_log (sector, c->block);
+  c->open_cnt--;
+}
+
+/* Records DATA as the new contents of metadata SECTOR in the
+   running transaction.  The caller must have just written DATA
+   to SECTOR's buffer cache entry and must still have the entry
+   pinned. */
+void
+journal_log (block_sector_t sector, const void *data)
+{
+  struct jblock *jb;
+
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  jb = jblock_find (sector);
+  if (jb == NULL)
+    {
+      jb = malloc (sizeof *jb);
+      if (jb == NULL)
+        PANIC ("Not enough memory for journal.");
+      jb->sector = sector;
+      jb->running = jb->committed = NULL;
+      hash_insert (&jblocks, &jb->hash_elem);
+    }
+  if (jb->running == NULL)
+    {
+      jb->running = malloc (BLOCK_SECTOR_SIZE);
+      if (jb->running == NULL)
+        PANIC ("Not enough memory for journal.");
+      list_push_back (&running_list, &jb->run_elem);
+      running_cnt++;
+    }
+  memcpy (jb->running, data, BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+}
+
+/* Notes that SECTOR has been freed by the running transaction.
+   Forgets any images of it, so that it may later be reused for
+   file data, and revokes images already in the log. */
+void
+journal_release (block_sector_t sector)
+{
+  struct jblock *jb;
+
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  bitmap_mark (freed, sector);
+  jb = jblock_find (sector);
+  if (jb != NULL)
+    {
+      if (jb->running != NULL)
+        {
+          list_remove (&jb->run_elem);
+          running_cnt--;
+          free (jb->running);
+        }
+      if (jb->committed != NULL)
+        {
+          list_remove (&jb->commit_elem);
+          free (jb->committed);
+
+          if (revoke_cnt >= revoke_cap)
+            {
+              size_t new_cap = revoke_cap ? revoke_cap * 2 : 16;
+              block_sector_t *new_revokes;
+
+              new_revokes = realloc (revokes, new_cap * sizeof *revokes);
+              if (new_revokes != NULL)
+                {
+                  revokes = new_revokes;
+                  revoke_cap = new_cap;
+                }
+            }
+          if (revoke_cnt < revoke_cap)
+            revokes[revoke_cnt++] = sector;
+          else
+            {
+              /* No memory to record the revocation, so empty
+                 the log instead; then there is nothing to
+                 revoke. */
+              checkpoint (false);
+            }
+        }
+      hash_delete (&jblocks, &jb->hash_elem);
+      free (jb);
+    }
+  lock_release (&journal_lock);
+}
+
+/* Returns true if none of the CNT sectors starting at SECTOR
+   was freed by the running transaction, so they may be
+   allocated again. */
+bool
+journal_reusable (block_sector_t sector, size_t cnt)
+{
+  bool reusable;
+
+  if (!enabled)
+    return true;
+
+  lock_acquire (&journal_lock);
+  reusable = !bitmap_contains (freed, sector, cnt, true);
+  lock_release (&journal_lock);
+  return reusable;
+}
+
+/* Returns true if the journal has an image of SECTOR, in which
+   case the buffer cache must not write SECTOR to disk. */
+bool
+journal_holds (block_sector_t sector)
+{
+  bool holds;
+
+  if (!enabled)
+    return false;
+
+  lock_acquire (&journal_lock);
+  holds = jblock_find (sector) != NULL;
+  lock_release (&journal_lock);
+  return holds;
+}
+
+/* If the journal has an image of SECTOR, copies the newest one
+   into BUFFER and returns true.  Otherwise returns false, and
+   SECTOR's contents on disk are current. */
+bool
+journal_read (block_sector_t sector, void *buffer)
+{
+  struct jblock *jb;
+
+  if (!enabled)
+    return false;
+
+  lock_acquire (&journal_lock);
+  jb = jblock_find (sector);
+  if (jb != NULL)
+    memcpy (buffer, jb->running != NULL ? jb->running : jb->committed,
+            BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+  return jb != NULL;
+}
+
+/* Commits the running transaction, waiting for operations in
+   progress to finish and holding off new ones meanwhile.  Must
+   not be called from within an operation. */
+void
+journal_commit (void)
+{
+  if (!enabled)
+    return;
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  lock_acquire (&journal_lock);
+  commit_exclusive ();
+  lock_release (&journal_lock);
+}
+
+/* Makes every metadata change made so far durable, by committing
+   the running transaction or, on a disk without a journal, by
+   writing back the whole buffer cache.  Must not be called from
+   within an operation. */
+void
+journal_sync (void)
+{
+  if (enabled)
+    journal_commit ();
+  else
+    cache_write_all (false);
+}
+
+/* Copies committed images to their home sectors and empties the
+   log.  Unless FORCE is true, does so only once the log is at
+   least half full. */
+void
+journal_checkpoint (bool force)
+{
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  if (force || used >= header.size / 2)
+    {
+      begin_exclusive ();
+      checkpoint (true);
+      end_exclusive ();
+    }
+  lock_release (&journal_lock);
+}
+
+/* Waits until no other commit or checkpoint is under way, then
+   holds off new operations and waits for those in progress to
+   end, giving the caller exclusive use of the log.  The caller
+   must hold journal_lock and must not be within an operation. */
+static void
+begin_exclusive (void)
+{
+  while (commit_wanted)
+    cond_wait (&journal_cond, &journal_lock);
+  commit_wanted = true;
+  while (active_cnt > 0)
+    cond_wait (&journal_cond, &journal_lock);
+}
+
+/* Gives up exclusive use of the log taken by begin_exclusive(). */
+static void
+end_exclusive (void)
+{
+  commit_wanted = false;
+  cond_broadcast (&journal_cond, &journal_lock);
+}
+
+/* Commits the running transaction, taking exclusive use of the
+   log to do so.  The caller must hold journal_lock and must not
+   be within an operation. */
+static void
+commit_exclusive (void)
+{
+  begin_exclusive ();
+  commit_running ();
+  end_exclusive ();
+}
+
+/* Returns the jblock for SECTOR, or a null pointer if there is
+   none.  The caller must hold journal_lock. */
+static struct jblock *
+jblock_find (block_sector_t sector)
+{
+  struct jblock key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&jblocks, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct jblock, hash_elem) : NULL;
+}
+
+/* Returns a hash value for the jblock containing E. */
+static unsigned
+jblock_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct jblock *jb = hash_entry (e, struct jblock, hash_elem);
+  return hash_int (jb->sector);
+}
+
+/* Returns true if the jblock containing A precedes the one
+   containing B. */
+static bool
+jblock_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct jblock *a = hash_entry (a_, struct jblock, hash_elem);
+  const struct jblock *b = hash_entry (b_, struct jblock, hash_elem);
+  return a->sector < b->sector;
+}
+
+/* Orders jblocks on committed_list by sector. */
+static bool
+jblock_sector_less (const struct list_elem *a_, const struct list_elem *b_,
+                    void *aux UNUSED)
+{
+  const struct jblock *a = list_entry (a_, struct jblock, commit_elem);
+  const struct jblock *b = list_entry (b_, struct jblock, commit_elem);
+  return a->sector < b->sector;
+}
+
+/* Writes the running transaction to the log, followed by its
+   commit block, and makes its images the committed ones.  The
+   caller must hold journal_lock and exclusive use of the log;
+   journal_lock is released while the log is written. */
+static void
+commit_running (void)
+{
+  static struct journal_desc desc;
+  size_t needed;
+  struct list_elem *e;
+  size_t r;
+
+  ASSERT (commit_wanted && active_cnt == 0);
+
+  if (running_cnt == 0 && revoke_cnt == 0)
+    return;
+
+  needed = (DIV_ROUND_UP (running_cnt + revoke_cnt, DESC_ENTRIES)
+            + running_cnt + 1);
+  if (needed > header.size - used)
+    checkpoint (true);
+  if (needed > header.size - used)
+    {
+      /* Only a single operation larger than the log gets here. */
+      write_through ();
+      return;
+    }
+
+  lock_release (&journal_lock);
+
+  /* Descriptor blocks, each followed by the images it lists. */
+  e = list_begin (&running_list);
+  r = 0;
+  while (e != list_end (&running_list) || r < revoke_cnt)
+    {
+      struct list_elem *first = e;
+      size_t i = 0;
+
+      memset (&desc, 0, sizeof desc);
+      desc.magic = DESC_MAGIC;
+      desc.seq = running_seq;
+      for (; e != list_end (&running_list) && i < DESC_ENTRIES;
+           e = list_next (e))
+        desc.sectors[i++] = list_entry (e, struct jblock, run_elem)->sector;
+      desc.block_cnt = i;
+      while (i < DESC_ENTRIES && r < revoke_cnt)
+        desc.sectors[i++] = revokes[r++];
+      desc.revoke_cnt = i - desc.block_cnt;
+      log_write (&desc);
+
+      for (; first != e; first = list_next (first))
+        log_write (list_entry (first, struct jblock, run_elem)->running);
+    }
+
+  /* Commit block.  Once it is on disk, the transaction will be
+     replayed after a crash. */
+  memset (&desc, 0, sizeof desc);
+  desc.magic = COMMIT_MAGIC;
+  desc.seq = running_seq;
+  log_write (&desc);
+
+  lock_acquire (&journal_lock);
+  while (!list_empty (&running_list))
+    {
+      struct jblock *jb = list_entry (list_pop_front (&running_list),
+                                      struct jblock, run_elem);
+      if (jb->committed != NULL)
+        free (jb->committed);
+      else
+        list_push_back (&committed_list, &jb->commit_elem);
+      jb->committed = jb->running;
+      jb->running = NULL;
+    }
+  running_cnt = 0;
+  revoke_cnt = 0;
+  bitmap_set_all (freed, false);
+  running_seq++;
+}
+
+/* Writes the running transaction's images directly to their
+   home sectors, for a transaction too large for the log.  Such a
+   transaction is not atomic.  The log must be empty.  The caller
+   must hold journal_lock. */
+static void
+write_through (void)
+{
+  ASSERT (list_empty (&committed_list));
+
+  while (!list_empty (&running_list))
+    {
+      struct jblock *jb = list_entry (list_pop_front (&running_list),
+                                      struct jblock, run_elem);
+      block_write (fs_device, jb->sector, jb->running);
+      free (jb->running);
+      hash_delete (&jblocks, &jb->hash_elem);
+      free (jb);
+    }
+  running_cnt = 0;
+  revoke_cnt = 0;
+  bitmap_set_all (freed, false);
+}
+
+/* Copies every committed image to its home sector, in sector
+   order, then marks the log empty.  The caller must hold
+   journal_lock.  If EXCLUSIVE is true, the caller also has
+   exclusive use of the log, and journal_lock is released while
+   the images are written. */
+static void
+checkpoint (bool exclusive)
+{
+  struct list_elem *e;
+
+  list_sort (&committed_list, jblock_sector_less, NULL);
+  if (exclusive)
+    {
+      lock_release (&journal_lock);
+      for (e = list_begin (&committed_list); e != list_end (&committed_list);
+           e = list_next (e))
+        {
+          struct jblock *jb = list_entry (e, struct jblock, commit_elem);
+          block_write (fs_device, jb->sector, jb->committed);
+        }
+      lock_acquire (&journal_lock);
+    }
+  while (!list_empty (&committed_list))
+    {
+      struct jblock *jb = list_entry (list_pop_front (&committed_list),
+                                      struct jblock, commit_elem);
+      if (!exclusive)
+        block_write (fs_device, jb->sector, jb->committed);
+      free (jb->committed);
+      jb->committed = NULL;
+      if (jb->running == NULL)
+        {
+          hash_delete (&jblocks, &jb->hash_elem);
+          free (jb);
+        }
+    }
+
+  /* Revocations only matter for images in the log. */
+  revoke_cnt = 0;
+
+  header.tail = head;
+  header.seq = running_seq;
+  used = 0;
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+}
+
+/* Writes sector DATA at the head of the log. */
+static void
+log_write (const void *data)
+{
+  block_write (fs_device, header.start + head, data);
+  head = (head + 1) % header.size;
+  used++;
+}
+
+/* Replays the transactions committed to the log, then empties
+   the log. */
+static void
+recover (void)
+{
+  struct revocation *revoked = NULL;
+  size_t revoked_cnt = 0, revoked_cap = 0;
+  uint32_t pos, seq, end_seq;
+
+  /* Find the committed transactions and what they revoke. */
+  pos = header.tail;
+  for (seq = header.seq;
+       scan_transaction (&pos, seq, &revoked, &revoked_cnt, &revoked_cap);
+       seq++)
+    continue;
+  end_seq = seq;
+
+  /* Replay them in order. */
+  pos = header.tail;
+  for (seq = header.seq; seq != end_seq; seq++)
+    replay_transaction (&pos, seq, revoked, revoked_cnt);
+  free (revoked);
+
+  if (end_seq != header.seq)
+    printf ("filesys: replayed %u journal transactions\n",
+            (unsigned) (end_seq - header.seq));
+
+  /* Skip END_SEQ, which a partly written transaction may have
+     used, so that its blocks cannot be mistaken for new ones. */
+  head = pos;
+  running_seq = end_seq + 1;
+  header.tail = head;
+  header.seq = running_seq;
+  used = 0;
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+}
+
+/* Checks whether transaction SEQ, starting at log position
+   *POSP, was completely written.  If so, advances *POSP past it,
+   adds its revocations to the array *REVOKEDP of *CNTP elements
+   with room for *CAPP, and returns true.  Otherwise returns
+   false. */
+static bool
+scan_transaction (uint32_t *posp, uint32_t seq,
+                  struct revocation **revokedp, size_t *cntp, size_t *capp)
+{
+  static struct journal_desc desc;
+  uint32_t pos = *posp;
+  uint32_t scanned = 0;
+
+  /* Make sure the commit block was written. */
+  for (;;)
+    {
+      if (scanned >= header.size)
+        return false;
+      block_read (fs_device, header.start + pos, &desc);
+      if (desc.seq != seq)
+        return false;
+      if (desc.magic == COMMIT_MAGIC)
+        break;
+      if (desc.magic != DESC_MAGIC
+          || desc.block_cnt + desc.revoke_cnt > DESC_ENTRIES)
+        return false;
+      scanned += 1 + desc.block_cnt;
+      pos = (pos + 1 + desc.block_cnt) % header.size;
+    }
+
+  /* Note its revocations. */
+  for (pos = *posp; ; pos = (pos + 1 + desc.block_cnt) % header.size)
+    {
+      size_t i;
+
+      block_read (fs_device, header.start + pos, &desc);
+      if (desc.magic == COMMIT_MAGIC)
+        break;
+
+      for (i = desc.block_cnt; i < desc.block_cnt + desc.revoke_cnt; i++)
+        {
+          block_sector_t sector = desc.sectors[i];
+          size_t j;
+
+          for (j = 0; j < *cntp; j++)
+            if ((*revokedp)[j].sector == sector)
+              break;
+          if (j == *cntp)
+            {
+              if (*cntp >= *capp)
+                {
+                  size_t new_cap = *capp ? *capp * 2 : 16;
+                  struct revocation *new_revoked;
+
+                  new_revoked = realloc (*revokedp,
+                                         new_cap * sizeof **revokedp);
+                  if (new_revoked == NULL)
+                    PANIC ("Not enough memory for journal recovery.");
+                  *revokedp = new_revoked;
+                  *capp = new_cap;
+                }
+              (*revokedp)[(*cntp)++].sector = sector;
+            }
+          (*revokedp)[j].seq = seq;
+        }
+    }
+
+  *posp = (pos + 1) % header.size;
+  return true;
+}
+
+/* Copies the images of transaction SEQ, which starts at log
+   position *POSP and is known to be complete, to their home
+   sectors, except those revoked by it or a later transaction
+   among the CNT in REVOKED.  Advances *POSP past it. */
+static void
+replay_transaction (uint32_t *posp, uint32_t seq,
+                    const struct revocation *revoked, size_t cnt)
+{
+  static struct journal_desc desc;
+  static uint8_t image[BLOCK_SECTOR_SIZE];
+  uint32_t pos = *posp;
+
+  for (;;)
+    {
+      size_t i;
+
+      block_read (fs_device, header.start + pos, &desc);
+      pos = (pos + 1) % header.size;
+      if (desc.magic == COMMIT_MAGIC)
+        break;
+
+      for (i = 0; i < desc.block_cnt; i++)
+        {
+          block_sector_t sector = desc.sectors[i];
+          size_t j;
+
+          for (j = 0; j < cnt; j++)
+            if (revoked[j].sector == sector && revoked[j].seq >= seq)
+              break;
+          if (j == cnt)
+            {
+              block_read (fs_device, header.start + pos, image);
+              block_write (fs_device, sector, image);
+            }
+          pos = (pos + 1) % header.size;
+        }
+    }
+  *posp = pos;
+}
@@ -0,0 +1,21 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+void journal_create (void);
+void journal_init (void);
+void journal_begin (void);
+void journal_end (void);
+void journal_write (block_sector_t, const void *);
+void journal_log (block_sector_t, const void *);
+void journal_release (block_sector_t);
+bool journal_reusable (block_sector_t, size_t cnt);
+bool journal_holds (block_sector_t);
+bool journal_read (block_sector_t, void *);
+void journal_commit (void);
+void journal_sync (void);
+void journal_checkpoint (bool force);
+
+#endif /* filesys/journal.h */
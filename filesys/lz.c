@@ -0,0 +1,172 @@
+#include "filesys/lz.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+
+/* A small, fast LZ77 codec in the format of LZF.  The compressed
+   data is a sequence of items, each starting with a control byte
+   C:
+
+     C < 32: a run of C + 1 literal bytes follows.
+
+     C >= 32: a back reference.  Its length, less 2, is C >> 5,
+     plus the next byte if that is 7.  Its distance back, less 1,
+     is (C & 0x1f) << 8 plus the byte after that.
+
+   The compressor finds matches through a hash table of recent
+   three-byte strings.  It trades ratio for speed, which suits
+   text and log data, where it typically halves the size or
+   better. */
+
+#define MAX_LIT 32                      /* Longest literal run. */
+#define MAX_REF (7 + 255 + 2)           /* Longest back reference. */
+#define MAX_DIST 8192                   /* Farthest back reference. */
+#define HASH_BITS 10                    /* Size of hash table. */
+
+/* Returns the hash table slot for the three bytes at P. */
+static inline unsigned
+hash3 (const uint8_t *p)
+{
+  unsigned v = (p[0] << 16) | (p[1] << 8) | p[2];
+  return ((v * 2654435761u) >> (32 - HASH_BITS)) & ((1u << HASH_BITS) - 1);
+}
+
+/* Appends the LIT_CNT literal bytes at LIT to OUT, whose first
+   *OPP bytes are used, as runs of at most MAX_LIT bytes.
+   Returns false if that would take more than OUT_CAP bytes. */
+static bool
+put_literals (uint8_t *out, size_t *opp, size_t out_cap,
+              const uint8_t *lit, size_t lit_cnt)
+{
+  size_t op = *opp;
+
+  while (lit_cnt > 0)
+    {
+      size_t run = lit_cnt < MAX_LIT ? lit_cnt : MAX_LIT;
+      if (op + 1 + run > out_cap)
+        return false;
+      out[op++] = run - 1;
+      memcpy (out + op, lit, run);
+      op += run;
+      lit += run;
+      lit_cnt -= run;
+    }
+  *opp = op;
+  return true;
+}
+
+/* Compresses the IN_LEN bytes at IN into OUT, which has room for
+   OUT_CAP bytes.  Returns the compressed size, or 0 if the data
+   did not fit in OUT_CAP bytes or memory ran out. */
+size_t
+lz_compress (const void *in_, size_t in_len, void *out_, size_t out_cap)
+{
+  const uint8_t *in = in_;
+  uint8_t *out = out_;
+  uint16_t *table;
+  size_t ip = 0, op = 0, lit = 0;
+
+  /* Table entries hold a position plus 1, so that 0 is empty. */
+  table = calloc (1u << HASH_BITS, sizeof *table);
+  if (table == NULL)
+    return 0;
+
+  while (ip + 2 < in_len)
+    {
+      unsigned h = hash3 (in + ip);
+      size_t ref = table[h];
+
+      table[h] = ip + 1;
+      if (ref-- != 0 && ip - ref <= MAX_DIST
+          && in[ref] == in[ip] && in[ref + 1] == in[ip + 1]
+          && in[ref + 2] == in[ip + 2])
+        {
+          size_t max = in_len - ip < MAX_REF ? in_len - ip : MAX_REF;
+          size_t len = 3;
+          size_t dist = ip - ref - 1;
+
+          while (len < max && in[ref + len] == in[ip + len])
+            len++;
+          if (!put_literals (out, &op, out_cap, in + ip - lit, lit)
+              || op + 3 > out_cap)
+            goto overflow;
+          lit = 0;
+
+          if (len - 2 < 7)
+            out[op++] = ((len - 2) << 5) | (dist >> 8);
+          else
+            {
+              out[op++] = (7 << 5) | (dist >> 8);
+              out[op++] = len - 2 - 7;
+            }
+          out[op++] = dist & 0xff;
+          ip += len;
+        }
+      else
+        {
+          ip++;
+          lit++;
+        }
+    }
+  lit += in_len - ip;
+  if (!put_literals (out, &op, out_cap, in + in_len - lit, lit))
+    goto overflow;
+
+  free (table);
+  return op;
+
+ overflow:
+  free (table);
+  return 0;
+}
+
+/* Decompresses the IN_LEN bytes at IN, produced by lz_compress(),
+   into OUT, which has room for OUT_CAP bytes.  Returns the
+   decompressed size, or 0 if IN is corrupt or does not fit. */
+size_t
+lz_decompress (const void *in_, size_t in_len, void *out_, size_t out_cap)
+{
+  const uint8_t *in = in_;
+  uint8_t *out = out_;
+  size_t ip = 0, op = 0;
+
+  while (ip < in_len)
+    {
+      unsigned ctrl = in[ip++];
+
+      if (ctrl < MAX_LIT)
+        {
+          size_t run = ctrl + 1;
+          if (ip + run > in_len || op + run > out_cap)
+            return 0;
+          memcpy (out + op, in + ip, run);
+          ip += run;
+          op += run;
+        }
+      else
+        {
+          size_t len = ctrl >> 5;
+          size_t dist;
+
+          if (len == 7)
+            {
+              if (ip >= in_len)
+                return 0;
+              len += in[ip++];
+            }
+          len += 2;
+          if (ip >= in_len)
+            return 0;
+          dist = ((ctrl & 0x1f) << 8) + in[ip++] + 1;
+          if (dist > op || op + len > out_cap)
+            return 0;
+
+          /* Byte by byte, since the reference may overlap what
+             it produces. */
+          for (; len > 0; len--, op++)
+            out[op] = out[op - dist];
+        }
+    }
+  return op;
+}
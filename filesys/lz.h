@@ -0,0 +1,10 @@
+#ifndef FILESYS_LZ_H
+#define FILESYS_LZ_H
+
+#include <stddef.h>
+
+size_t lz_compress (const void *in, size_t in_len, void *out, size_t out_cap);
+size_t lz_decompress (const void *in, size_t in_len, void *out,
+                      size_t out_cap);
+
+#endif /* filesys/lz.h */
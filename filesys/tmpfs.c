@@ -0,0 +1,350 @@
+#include "filesys/tmpfs.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The tmpfs holds files and directories entirely in memory, one
+   palloc page at a time, so reading and writing them never
+   touches the buffer cache or the disk, and they are gone after
+   a reboot.  It suits scratch data that does not need to outlive
+   the run.
+
+   Its root directory is mounted over a directory of the disk
+   file system: once it is mounted, opening that directory's
+   inode opens the tmpfs root instead.  Tmpfs nodes are opened as
+   ordinary inodes, so files and directories work on them
+   unchanged, but their inode numbers come from a range of their
+   own, starting at TMPFS_INODE_BASE. */
+
+static struct hash nodes;               /* All nodes, by inode number. */
+static struct lock tmpfs_lock;          /* Protects nodes and their data. */
+static block_sector_t next_inumber;     /* Next inode number to use. */
+
+static block_sector_t covered_sector;   /* Directory mounted over. */
+static struct inode *root_inode;        /* Root, open while mounted. */
+
+static hash_hash_func node_hash;
+static hash_less_func node_less;
+static uint8_t *get_page (struct tmpfs_node *, size_t idx, bool create);
+static void free_node (struct tmpfs_node *);
+
+/* Initializes the tmpfs.  Nothing is mounted yet. */
+void
+tmpfs_init (void)
+{
+  hash_init (&nodes, node_hash, node_less, NULL);
+  lock_init (&tmpfs_lock);
+  next_inumber = TMPFS_INODE_BASE;
+}
+
+/* Mounts a new, empty tmpfs over the directory named PATH, which
+   is created if it does not exist.  Only one tmpfs may be
+   mounted, and not inside another.  Returns true if successful,
+   false on failure. */
+bool
+tmpfs_mount (const char *path)
+{
+  char name[NAME_MAX + 1];
+  struct dir *dir;
+  struct inode *inode = NULL;
+  struct tmpfs_node *root;
+  block_sector_t root_inumber;
+
+  if (root_inode != NULL)
+    return false;
+  dir = get_dir (path, false, name);
+  if (dir == NULL || *name == '\0'
+      || tmpfs_is_tmpfs (inode_get_inumber (dir_get_inode (dir))))
+    {
+      dir_close (dir);
+      return false;
+    }
+  if (!dir_lookup (dir, name, &inode) && filesys_create (path, 0, true))
+    dir_lookup (dir, name, &inode);
+  if (inode == NULL || !inode_is_dir (inode)
+      || !tmpfs_create (&root_inumber, 0, true))
+    {
+      inode_close (inode);
+      dir_close (dir);
+      return false;
+    }
+
+  /* ".." in the root leads back out of the tmpfs. */
+  root = tmpfs_lookup (root_inumber);
+  root->parent = inode_get_inumber (dir_get_inode (dir));
+  tmpfs_put (root);
+  covered_sector = inode_get_inumber (inode);
+  inode_close (inode);
+  dir_close (dir);
+
+  root_inode = inode_open (root_inumber);
+  return root_inode != NULL;
+}
+
+/* Returns true if INUMBER is the inode number of a tmpfs node. */
+bool
+tmpfs_is_tmpfs (block_sector_t inumber)
+{
+  return inumber >= TMPFS_INODE_BASE;
+}
+
+/* Returns the inode number of the tmpfs root if SECTOR holds
+   the directory it is mounted over, otherwise SECTOR. */
+block_sector_t
+tmpfs_covered (block_sector_t sector)
+{
+  if (root_inode != NULL && sector == covered_sector)
+    return inode_get_inumber (root_inode);
+  return sector;
+}
+
+/* Creates a tmpfs node LENGTH bytes long, which is a directory
+   if ISDIR is true, and stores its inode number in *INUMBERP.
+   Its data reads as zeros; pages are added only as it is
+   written.  Returns true if successful, false if memory is
+   short. */
+bool
+tmpfs_create (block_sector_t *inumberp, off_t length, bool isdir)
+{
+  struct tmpfs_node *node = malloc (sizeof *node);
+  if (node == NULL)
+    return false;
+
+  node->parent = ROOT_DIR_SECTOR;
+  node->length = length;
+  node->isdir = isdir;
+  node->pages = NULL;
+  node->page_cnt = 0;
+  node->ref_cnt = 0;
+  node->removed = false;
+
+  lock_acquire (&tmpfs_lock);
+  node->inumber = next_inumber++;
+  hash_insert (&nodes, &node->elem);
+  lock_release (&tmpfs_lock);
+
+  *inumberp = node->inumber;
+  return true;
+}
+
+/* Returns the tmpfs node with inode number INUMBER, or a null
+   pointer if there is none.  The reference to the node is taken
+   while tmpfs_lock is held, so the node stays allocated until
+   the caller gives it back with tmpfs_put() or tmpfs_release(). */
+struct tmpfs_node *
+tmpfs_lookup (block_sector_t inumber)
+{
+  struct tmpfs_node key;
+  struct tmpfs_node *node = NULL;
+  struct hash_elem *e;
+
+  key.inumber = inumber;
+  lock_acquire (&tmpfs_lock);
+  e = hash_find (&nodes, &key.elem);
+  if (e != NULL)
+    {
+      node = hash_entry (e, struct tmpfs_node, elem);
+      node->ref_cnt++;
+    }
+  lock_release (&tmpfs_lock);
+  return node;
+}
+
+/* Gives back a reference to NODE obtained from tmpfs_lookup(),
+   freeing NODE if it has been deleted and this was the last
+   reference. */
+void
+tmpfs_put (struct tmpfs_node *node)
+{
+  bool last;
+
+  lock_acquire (&tmpfs_lock);
+  last = --node->ref_cnt == 0 && node->removed;
+  lock_release (&tmpfs_lock);
+  if (last)
+    free_node (node);
+}
+
+/* Deletes NODE, so that tmpfs_lookup() no longer finds it, and
+   gives back the caller's reference to it.  NODE and its pages
+   are freed once no other references remain. */
+void
+tmpfs_release (struct tmpfs_node *node)
+{
+  lock_acquire (&tmpfs_lock);
+  if (!node->removed)
+    {
+      hash_delete (&nodes, &node->elem);
+      node->removed = true;
+    }
+  lock_release (&tmpfs_lock);
+  tmpfs_put (node);
+}
+
+/* Frees NODE and its pages. */
+static void
+free_node (struct tmpfs_node *node)
+{
+  size_t i;
+
+  for (i = 0; i < node->page_cnt; i++)
+    if (node->pages[i] != NULL)
+      palloc_free_page (node->pages[i]);
+  free (node->pages);
+  free (node);
+}
+
+/* Reads SIZE bytes from NODE into BUFFER, starting at OFFSET.
+   The caller must not read past end of file.  Parts that were
+   never written read as zeros.  Returns SIZE. */
+off_t
+tmpfs_read (struct tmpfs_node *node, void *buffer_, off_t size, off_t offset)
+{
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  lock_acquire (&tmpfs_lock);
+  while (bytes_read < size)
+    {
+      uint8_t *page = get_page (node, offset / PGSIZE, false);
+      int page_ofs = offset % PGSIZE;
+      int chunk_size = PGSIZE - page_ofs;
+      if (chunk_size > size - bytes_read)
+        chunk_size = size - bytes_read;
+
+      if (page != NULL)
+        memcpy (buffer + bytes_read, page + page_ofs, chunk_size);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
+      offset += chunk_size;
+      bytes_read += chunk_size;
+    }
+  lock_release (&tmpfs_lock);
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into NODE, starting at OFFSET,
+   adding pages as needed.  Does not change NODE's length.
+   Returns the number of bytes written, which is less than SIZE
+   if memory runs out. */
+off_t
+tmpfs_write (struct tmpfs_node *node, const void *buffer_, off_t size,
+             off_t offset)
+{
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = 0;
+
+  lock_acquire (&tmpfs_lock);
+  while (bytes_written < size)
+    {
+      uint8_t *page = get_page (node, offset / PGSIZE, true);
+      int page_ofs = offset % PGSIZE;
+      int chunk_size = PGSIZE - page_ofs;
+      if (chunk_size > size - bytes_written)
+        chunk_size = size - bytes_written;
+
+      if (page == NULL)
+        break;
+      memcpy (page + page_ofs, buffer + bytes_written, chunk_size);
+      offset += chunk_size;
+      bytes_written += chunk_size;
+    }
+  lock_release (&tmpfs_lock);
+  return bytes_written;
+}
+
+/* Adds the pages NODE needs to hold LEN bytes at OFFSET, without
+   changing its length.  Returns true if successful, false if
+   memory ran out. */
+bool
+tmpfs_reserve (struct tmpfs_node *node, off_t offset, off_t len)
+{
+  size_t idx;
+  bool success = true;
+  size_t last = (offset + len - 1) / PGSIZE;
+
+  if (len <= 0)
+    return true;
+  lock_acquire (&tmpfs_lock);
+  for (idx = offset / PGSIZE; success && idx <= last; idx++)
+    success = get_page (node, idx, true) != NULL;
+  lock_release (&tmpfs_lock);
+  return success;
+}
+
+/* Frees NODE's pages past LENGTH bytes and zeroes the rest of
+   the page that LENGTH falls in, so that growing NODE again
+   reads back zeros.  Does not change NODE's length. */
+void
+tmpfs_truncate (struct tmpfs_node *node, off_t length)
+{
+  size_t idx;
+  uint8_t *page;
+
+  lock_acquire (&tmpfs_lock);
+  for (idx = DIV_ROUND_UP (length, PGSIZE); idx < node->page_cnt; idx++)
+    if (node->pages[idx] != NULL)
+      {
+        palloc_free_page (node->pages[idx]);
+        node->pages[idx] = NULL;
+      }
+  page = get_page (node, length / PGSIZE, false);
+  if (page != NULL && length % PGSIZE != 0)
+    memset (page + length % PGSIZE, 0, PGSIZE - length % PGSIZE);
+  lock_release (&tmpfs_lock);
+}
+
+/* Returns page IDX of NODE's data, or a null pointer if it has
+   none.  If CREATE is true, adds a zeroed page instead, and
+   returns a null pointer only if memory is short.  The caller
+   must hold tmpfs_lock. */
+static uint8_t *
+get_page (struct tmpfs_node *node, size_t idx, bool create)
+{
+  if (idx >= node->page_cnt)
+    {
+      size_t new_cnt = node->page_cnt * 2;
+      uint8_t **pages;
+
+      if (new_cnt <= idx)
+        new_cnt = idx + 1;
+      if (!create)
+        return NULL;
+      pages = realloc (node->pages, new_cnt * sizeof *pages);
+      if (pages == NULL)
+        return NULL;
+      memset (pages + node->page_cnt, 0,
+              (new_cnt - node->page_cnt) * sizeof *pages);
+      node->pages = pages;
+      node->page_cnt = new_cnt;
+    }
+  if (node->pages[idx] == NULL && create)
+    node->pages[idx] = palloc_get_page (PAL_ZERO);
+  return node->pages[idx];
+}
+
+/* Returns a hash value for the node containing E. */
+static unsigned
+node_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct tmpfs_node *node = hash_entry (e, struct tmpfs_node, elem);
+  return hash_int (node->inumber);
+}
+
+/* Returns true if the node containing A precedes the one
+   containing B. */
+static bool
+node_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct tmpfs_node *a = hash_entry (a_, struct tmpfs_node, elem);
+  const struct tmpfs_node *b = hash_entry (b_, struct tmpfs_node, elem);
+  return a->inumber < b->inumber;
+}
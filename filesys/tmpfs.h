@@ -0,0 +1,44 @@
+#ifndef FILESYS_TMPFS_H
+#define FILESYS_TMPFS_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+/* Inode numbers of files in the tmpfs start here.  The free map
+   never hands out sectors at or past this point, even on a larger
+   disk, so that the two kinds of inode never collide. */
+#define TMPFS_INODE_BASE ((block_sector_t) 0x80000000)
+
+/* A file or directory in the tmpfs.  It plays the part of an
+   on-disk inode, but its data lives in pages of kernel memory. */
+struct tmpfs_node
+  {
+    struct hash_elem elem;              /* Element in the node table. */
+    block_sector_t inumber;             /* Inode number. */
+    block_sector_t parent;              /* Inode number of parent dir. */
+    off_t length;                       /* File size in bytes. */
+    bool isdir;                         /* Directory? */
+    uint8_t **pages;                    /* Data pages, null if unused. */
+    size_t page_cnt;                    /* Number of elements in pages. */
+    int ref_cnt;                        /* References from tmpfs_lookup(). */
+    bool removed;                       /* Deleted, freed at ref_cnt 0? */
+  };
+
+void tmpfs_init (void);
+bool tmpfs_mount (const char *path);
+bool tmpfs_is_tmpfs (block_sector_t inumber);
+block_sector_t tmpfs_covered (block_sector_t sector);
+bool tmpfs_create (block_sector_t *inumberp, off_t length, bool isdir);
+struct tmpfs_node *tmpfs_lookup (block_sector_t inumber);
+void tmpfs_put (struct tmpfs_node *);
+void tmpfs_release (struct tmpfs_node *);
+off_t tmpfs_read (struct tmpfs_node *, void *, off_t size, off_t offset);
+off_t tmpfs_write (struct tmpfs_node *, const void *, off_t size,
+                   off_t offset);
+bool tmpfs_reserve (struct tmpfs_node *, off_t offset, off_t len);
+void tmpfs_truncate (struct tmpfs_node *, off_t length);
+
+#endif /* filesys/tmpfs.h */
@@ -0,0 +1,37 @@
+#ifndef __LIB_BLOCKSTAT_H
+#define __LIB_BLOCKSTAT_H
+
+#include <stdint.h>
+
+/* Buckets in each time histogram.  Bucket I counts times of 2**I
+   to 2**(I+1) - 1 CPU cycles, and the last bucket also counts
+   anything longer. */
+#define BLOCKSTAT_BUCKETS 32
+
+/* Buckets in the queue depth histogram.  Bucket I counts requests
+   that found I others queued or in flight when submitted, and
+   the last bucket also counts deeper queues. */
+#define BLOCKSTAT_DEPTHS 16
+
+/* Statistics for one block device, as returned by the blockstat
+   system call.  All counts are totals since boot. */
+struct blockstat
+  {
+    char name[16];              /* Device name, e.g. "hda1". */
+    char role[16];              /* Type, e.g. "filesys" or "raw". */
+    uint64_t cycles_per_tick;   /* CPU cycles per timer tick. */
+    uint64_t reads;             /* Read requests. */
+    uint64_t writes;            /* Write requests. */
+    uint64_t read_bytes;        /* Bytes read. */
+    uint64_t write_bytes;       /* Bytes written. */
+    uint64_t transfers;         /* Driver transfers, after merging. */
+    uint64_t sequential;        /* Transfers that began where the
+                                   previous one ended. */
+    uint64_t lock_wait;         /* Cycles the driver waited for a
+                                   controller shared with others. */
+    uint64_t service[BLOCKSTAT_BUCKETS]; /* Time taken by transfers. */
+    uint64_t queued[BLOCKSTAT_BUCKETS];  /* Time requests spent queued. */
+    uint64_t depth[BLOCKSTAT_DEPTHS];    /* Queue depth on submission. */
+  };
+
+#endif /* lib/blockstat.h */
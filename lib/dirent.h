@@ -0,0 +1,29 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+#include <round.h>
+#include <stddef.h>
+
+/* A directory entry as returned by the getdents system call.
+   Entries are packed back to back in the caller's buffer.  Each
+   one is d_reclen bytes long, which covers the fixed members,
+   the name with its null terminator, and padding up to a 4-byte
+   boundary. */
+struct dirent
+  {
+    int d_ino;                  /* Inode number. */
+    unsigned short d_reclen;    /* Length of this record in bytes. */
+    unsigned char d_type;       /* Type of file, one of DT_*. */
+    char d_name[];              /* Null-terminated file name. */
+  };
+
+/* Values for d_type. */
+#define DT_UNKNOWN 0            /* Type not known. */
+#define DT_REG 1                /* Regular file. */
+#define DT_DIR 2                /* Directory. */
+
+/* Length of a record for a name of NAME_LEN characters. */
+#define DIRENT_RECLEN(NAME_LEN) \
+        ROUND_UP (offsetof (struct dirent, d_name) + (NAME_LEN) + 1, 4)
+
+#endif /* lib/dirent.h */
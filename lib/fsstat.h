@@ -0,0 +1,18 @@
+#ifndef __LIB_FSSTAT_H
+#define __LIB_FSSTAT_H
+
+#include <stdint.h>
+
+/* File system statistics, as returned by the fsstat system call.
+   All counts but FREE_SECTORS are totals since boot. */
+struct fsstat
+  {
+    int64_t ticks;              /* Timer ticks. */
+    uint64_t block_reads;       /* Sectors read from file system device. */
+    uint64_t block_writes;      /* Sectors written to it. */
+    uint64_t cache_hits;        /* Buffer cache lookups that hit. */
+    uint64_t cache_misses;      /* Buffer cache lookups that missed. */
+    uint64_t free_sectors;      /* Sectors now free for allocation. */
+  };
+
+#endif /* lib/fsstat.h */
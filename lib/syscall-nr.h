@@ -28,7 +28,21 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+    SYS_GETDENTS,               /* Reads many directory entries. */
+    SYS_FSSTAT,                 /* Reports file system statistics. */
+    SYS_OPEN_DIRECT,            /* Opens a file for uncached I/O. */
+    SYS_PREAD,                  /* Reads from a given file position. */
+    SYS_PWRITE,                 /* Writes at a given file position. */
+    SYS_READV,                  /* Reads into several buffers. */
+    SYS_WRITEV,                 /* Writes from several buffers. */
+    SYS_COPY_FILE_RANGE,        /* Copies data between two files. */
+    SYS_FSYNC,                  /* Writes a file's changes to disk. */
+    SYS_FDATASYNC,              /* Writes a file's data to disk. */
+    SYS_FTRUNCATE,              /* Changes a file's length. */
+    SYS_FALLOCATE,              /* Reserves space for a file. */
+    SYS_FCOMPRESS,              /* Stores a file compressed. */
+    SYS_BLOCKSTAT               /* Reports block device statistics. */
   };
 
 #endif /* lib/syscall-nr.h */
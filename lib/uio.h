@@ -0,0 +1,17 @@
+#ifndef __LIB_UIO_H
+#define __LIB_UIO_H
+
+#include <stddef.h>
+
+/* One buffer in a scatter/gather transfer, as passed to the
+   readv and writev system calls. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Length of buffer in bytes. */
+  };
+
+/* Maximum number of buffers in one readv or writev call. */
+#define IOV_MAX 16
+
+#endif /* lib/uio.h */
@@ -61,6 +61,25 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "g" (ARG0),                             \
+                 [arg1] "g" (ARG1),                             \
+                 [arg2] "g" (ARG2),                             \
+                 [arg3] "g" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
 void
 halt (void) 
 {
@@ -182,3 +201,87 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+getdents (int fd, void *buffer, unsigned size)
+{
+  return syscall3 (SYS_GETDENTS, fd, buffer, size);
+}
+
+bool
+fsstat (struct fsstat *st)
+{
+  return syscall1 (SYS_FSSTAT, st);
+}
+
+int
+open_direct (const char *file)
+{
+  return syscall1 (SYS_OPEN_DIRECT, file);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+copy_file_range (int fd_in, int fd_out, unsigned size)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, fd_in, fd_out, size);
+}
+
+bool
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
+bool
+fdatasync (int fd)
+{
+  return syscall1 (SYS_FDATASYNC, fd);
+}
+
+bool
+ftruncate (int fd, unsigned length)
+{
+  return syscall2 (SYS_FTRUNCATE, fd, length);
+}
+
+bool
+fallocate (int fd, unsigned offset, unsigned len)
+{
+  return syscall3 (SYS_FALLOCATE, fd, offset, len);
+}
+
+bool
+fcompress (int fd)
+{
+  return syscall1 (SYS_FCOMPRESS, fd);
+}
+
+bool
+blockstat (int index, struct blockstat *st)
+{
+  return syscall2 (SYS_BLOCKSTAT, index, st);
+}
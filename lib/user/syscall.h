@@ -2,7 +2,11 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <blockstat.h>
 #include <debug.h>
+#include <dirent.h>
+#include <fsstat.h>
+#include <uio.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -44,5 +48,19 @@ bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
+int getdents (int fd, void *buffer, unsigned size);
+bool fsstat (struct fsstat *);
+int open_direct (const char *file);
+int pread (int fd, void *buffer, unsigned size, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned size, unsigned offset);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int copy_file_range (int fd_in, int fd_out, unsigned size);
+bool fsync (int fd);
+bool fdatasync (int fd);
+bool ftruncate (int fd, unsigned length);
+bool fallocate (int fd, unsigned offset, unsigned len);
+bool fcompress (int fd);
+bool blockstat (int index, struct blockstat *);
 
 #endif /* lib/user/syscall.h */
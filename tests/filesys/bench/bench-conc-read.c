@@ -0,0 +1,34 @@
+/* Measures several processes reading the same file at the same
+   time. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+#include "tests/filesys/bench/conc-read.h"
+
+#define CHILD_CNT 4
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  struct bench b;
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+         "write \"%s\"", file_name);
+  close (fd);
+
+  bench_start (&b, "conc-read");
+  exec_children ("child-bench-read", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+  bench_end (&b, CHILD_CNT * (FILE_SIZE / CHUNK_SIZE),
+             (unsigned long long) CHILD_CNT * FILE_SIZE);
+}
@@ -0,0 +1,52 @@
+/* Measures creating, writing, closing and removing many small
+   files in rounds, as a build or a mail spool would. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define ROUND_CNT 4
+#define FILE_CNT 50
+#define FILE_SIZE 512
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void)
+{
+  struct bench b;
+  int round, i;
+
+  memset (buf, 'x', sizeof buf);
+  bench_start (&b, "create-delete");
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          char file_name[16];
+          int fd;
+
+          snprintf (file_name, sizeof file_name, "file%d", i);
+          if (!create (file_name, 0))
+            fail ("create \"%s\" failed", file_name);
+          if ((fd = open (file_name)) < 2)
+            fail ("open \"%s\" failed", file_name);
+          if (write (fd, buf, sizeof buf) != (int) sizeof buf)
+            fail ("write \"%s\" failed", file_name);
+          close (fd);
+        }
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          char file_name[16];
+
+          snprintf (file_name, sizeof file_name, "file%d", i);
+          if (!remove (file_name))
+            fail ("remove \"%s\" failed", file_name);
+        }
+    }
+  bench_end (&b, ROUND_CNT * FILE_CNT * 2,
+             (unsigned long long) ROUND_CNT * FILE_CNT * FILE_SIZE);
+}
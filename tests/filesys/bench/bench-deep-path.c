@@ -0,0 +1,42 @@
+/* Measures opening a file at the bottom of a deep directory
+   tree by its absolute path, which must walk every level of
+   the tree each time. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define DEPTH 16
+#define LOOKUP_CNT 500
+
+void
+test_main (void)
+{
+  char path[DEPTH * 4 + 16];
+  struct bench b;
+  int i;
+
+  path[0] = '\0';
+  for (i = 0; i < DEPTH; i++)
+    {
+      size_t len = strlen (path);
+      snprintf (path + len, sizeof path - len, "/d%d", i);
+      if (!mkdir (path))
+        fail ("mkdir \"%s\" failed", path);
+    }
+  strlcat (path, "/leaf", sizeof path);
+  CHECK (create (path, 0), "create leaf file");
+
+  bench_start (&b, "deep-path");
+  for (i = 0; i < LOOKUP_CNT; i++)
+    {
+      int fd = open (path);
+      if (fd < 2)
+        fail ("open \"%s\" failed", path);
+      close (fd);
+    }
+  bench_end (&b, LOOKUP_CNT, 0);
+}
@@ -0,0 +1,51 @@
+/* Measures looking up names, in random order, in a directory
+   that holds many files. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define FILE_CNT 200
+#define PASS_CNT 2
+
+static int order[FILE_CNT];
+
+void
+test_main (void)
+{
+  struct bench b;
+  int pass, i;
+
+  CHECK (mkdir ("big"), "mkdir \"big\"");
+  CHECK (chdir ("big"), "chdir \"big\"");
+  msg ("creating %d files...", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      char file_name[16];
+
+      snprintf (file_name, sizeof file_name, "file%d", i);
+      if (!create (file_name, 0))
+        fail ("create \"%s\" failed", file_name);
+      order[i] = i;
+    }
+
+  bench_start (&b, "large-dir");
+  for (pass = 0; pass < PASS_CNT; pass++)
+    {
+      shuffle (order, FILE_CNT, sizeof *order);
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          char file_name[16];
+          int fd;
+
+          snprintf (file_name, sizeof file_name, "file%d", order[i]);
+          if ((fd = open (file_name)) < 2)
+            fail ("open \"%s\" failed", file_name);
+          close (fd);
+        }
+    }
+  bench_end (&b, PASS_CNT * FILE_CNT, 0);
+}
@@ -0,0 +1,7 @@
+/* Measures reading 4 kB blocks at random offsets within a
+   file. */
+
+#define BENCH_NAME "rand-4k"
+#define BLOCK_SIZE 4096
+#define FILE_SIZE (128 * 1024)
+#include "tests/filesys/bench/random.inc"
@@ -0,0 +1,7 @@
+/* Measures reading 512-byte blocks at random offsets within a
+   file. */
+
+#define BENCH_NAME "rand-512"
+#define BLOCK_SIZE 512
+#define FILE_SIZE (128 * 1024)
+#include "tests/filesys/bench/random.inc"
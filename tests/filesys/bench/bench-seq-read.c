@@ -0,0 +1,25 @@
+/* Measures reading a large file sequentially, in 4 kB chunks. */
+
+#include "tests/filesys/bench/seq.inc"
+
+void
+test_main (void)
+{
+  struct bench b;
+  size_t ofs;
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  write_chunks (fd);
+  seek (fd, 0);
+
+  bench_start (&b, "seq-read");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    if (read (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+      fail ("read %d bytes at offset %zu failed", CHUNK_SIZE, ofs);
+  bench_end (&b, FILE_SIZE / CHUNK_SIZE, FILE_SIZE);
+
+  close (fd);
+}
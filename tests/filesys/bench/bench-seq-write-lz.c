@@ -0,0 +1,28 @@
+/* Measures writing a large file of log-like text sequentially,
+   in 4 kB chunks, to a file stored compressed.  Compare against
+   seq-write, which writes the same amount of random data
+   uncompressed. */
+
+#include <stdio.h>
+#include "tests/filesys/bench/seq.inc"
+
+void
+test_main (void)
+{
+  struct bench b;
+  size_t ofs;
+  int fd;
+
+  for (ofs = 0; ofs + 40 <= sizeof buf; ofs += 40)
+    snprintf (buf + ofs, 41, "%06zu INFO request served in %6d ms\n",
+              ofs / 40, (int) (ofs % 997));
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (fcompress (fd), "fcompress \"%s\"", file_name);
+
+  bench_start (&b, "seq-write-lz");
+  write_chunks (fd);
+  bench_end (&b, FILE_SIZE / CHUNK_SIZE, FILE_SIZE);
+
+  close (fd);
+}
@@ -0,0 +1,21 @@
+/* Measures writing a large file sequentially, in 4 kB chunks,
+   to a file that starts out empty. */
+
+#include "tests/filesys/bench/seq.inc"
+
+void
+test_main (void)
+{
+  struct bench b;
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  bench_start (&b, "seq-write");
+  write_chunks (fd);
+  bench_end (&b, FILE_SIZE / CHUNK_SIZE, FILE_SIZE);
+
+  close (fd);
+}
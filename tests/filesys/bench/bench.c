@@ -0,0 +1,36 @@
+#include "tests/filesys/bench/bench.h"
+#include <syscall.h>
+#include "tests/lib.h"
+
+/* Starts benchmark B, with the given NAME. */
+void
+bench_start (struct bench *b, const char *name)
+{
+  b->name = name;
+  if (!fsstat (&b->start))
+    fail ("fsstat failed");
+}
+
+/* Ends benchmark B, which performed OPS operations that
+   transferred BYTES bytes in total, and prints a single line
+   describing it.  The line has the form
+     BENCH <name> ticks=T reads=R writes=W hits=H misses=M ops=O bytes=B
+   where each value is the difference between the statistics
+   now and at the start of the benchmark, so that scripts can
+   compare the results of different builds. */
+void
+bench_end (struct bench *b, unsigned long long ops, unsigned long long bytes)
+{
+  struct fsstat end;
+
+  if (!fsstat (&end))
+    fail ("fsstat failed");
+  msg ("BENCH %s ticks=%lld reads=%llu writes=%llu hits=%llu misses=%llu "
+       "ops=%llu bytes=%llu", b->name,
+       (long long) (end.ticks - b->start.ticks),
+       (unsigned long long) (end.block_reads - b->start.block_reads),
+       (unsigned long long) (end.block_writes - b->start.block_writes),
+       (unsigned long long) (end.cache_hits - b->start.cache_hits),
+       (unsigned long long) (end.cache_misses - b->start.cache_misses),
+       ops, bytes);
+}
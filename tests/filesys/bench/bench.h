@@ -0,0 +1,17 @@
+#ifndef TESTS_FILESYS_BENCH_BENCH_H
+#define TESTS_FILESYS_BENCH_BENCH_H
+
+#include <fsstat.h>
+
+/* A benchmark in progress. */
+struct bench
+  {
+    const char *name;           /* Name printed in the BENCH line. */
+    struct fsstat start;        /* Statistics when it began. */
+  };
+
+void bench_start (struct bench *, const char *name);
+void bench_end (struct bench *, unsigned long long ops,
+                unsigned long long bytes);
+
+#endif /* tests/filesys/bench/bench.h */
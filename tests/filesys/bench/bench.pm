@@ -0,0 +1,36 @@
+# -*- perl -*-
+use strict;
+use warnings;
+
+# Checks the output of a benchmark that should have printed
+# BENCH lines for each of the given NAMES, in order, and passes
+# if it did.
+sub check_bench {
+    my (@names) = @_;
+    our ($test);
+
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+    @output = grep (!/^[a-zA-Z0-9-_]+: exit\(-?\d+\)$/,
+		    get_core_output ("run", @output));
+
+    my ($prog) = $test;
+    $prog =~ s%^.*/%%;
+    fail "missing begin message\n" if !@output || $output[0] ne "($prog) begin";
+    fail "missing end message\n"
+      if $output[$#output] ne "($prog) end";
+
+    foreach (@output) {
+	next if !/ BENCH /;
+	my ($name) = /^\(\Q$prog\E\) BENCH (\S+) ticks=-?\d+ reads=\d+ writes=\d+ hits=\d+ misses=\d+ ops=\d+ bytes=\d+$/
+	  or fail "malformed benchmark line: $_\n";
+	my ($expected) = shift (@names);
+	fail "unexpected benchmark \"$name\"\n" if !defined $expected;
+	fail "benchmark \"$name\" out of order, expected \"$expected\"\n"
+	  if $name ne $expected;
+    }
+    fail "missing benchmark \"$names[0]\"\n" if @names;
+    pass;
+}
+
+1;
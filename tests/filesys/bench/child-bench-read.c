@@ -0,0 +1,32 @@
+/* Child process for bench-conc-read.
+   Reads the whole test file, a chunk at a time. */
+
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/bench/conc-read.h"
+
+const char *test_name = "child-bench-read";
+
+static char buf[CHUNK_SIZE];
+
+int
+main (int argc, const char *argv[])
+{
+  int child_idx;
+  size_t ofs;
+  int fd;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    if (read (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+      fail ("read %d bytes at offset %zu failed", CHUNK_SIZE, ofs);
+  close (fd);
+
+  return child_idx;
+}
@@ -0,0 +1,8 @@
+#ifndef TESTS_FILESYS_BENCH_CONC_READ_H
+#define TESTS_FILESYS_BENCH_CONC_READ_H
+
+#define FILE_SIZE (64 * 1024)
+#define CHUNK_SIZE 512
+static const char file_name[] = "shared";
+
+#endif /* tests/filesys/bench/conc-read.h */
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+random_bytes (4096);
+check_archive ({"counted" => [random_bytes (4096)]});
+pass;
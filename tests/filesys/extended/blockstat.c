@@ -0,0 +1,92 @@
+/* Writes a file and makes it durable, then checks that the
+   statistics reported by blockstat() for the file system device
+   account for the writes consistently, and that a direct write
+   of whole sectors over the file counts exactly its own bytes. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[4096];
+
+/* Number of times to try the direct write.  The write-back thread
+   may add writes of its own to one attempt, but not to all. */
+#define DIRECT_TRIES 3
+
+/* Returns the sum of the CNT counts in HIST. */
+static uint64_t
+sum (const uint64_t *hist, int cnt)
+{
+  uint64_t total = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    total += hist[i];
+  return total;
+}
+
+void
+test_main (void)
+{
+  const char *file_name = "counted";
+  struct blockstat before, after;
+  int fs_index, i, fd, try;
+
+  fs_index = -1;
+  for (i = 0; blockstat (i, &before); i++)
+    if (!strcmp (before.role, "filesys"))
+      fs_index = i;
+  CHECK (fs_index >= 0, "find file system device");
+  CHECK (blockstat (fs_index, &before), "get statistics");
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write \"%s\"", file_name);
+  CHECK (fsync (fd), "fsync \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  CHECK (blockstat (fs_index, &after), "get statistics again");
+  if (after.write_bytes < before.write_bytes + sizeof buf)
+    fail ("only %"PRIu64" bytes written to file system device",
+          after.write_bytes - before.write_bytes);
+  if (after.sequential > after.transfers)
+    fail ("more sequential transfers than transfers");
+  if (sum (after.service, BLOCKSTAT_BUCKETS) != after.transfers)
+    fail ("service time histogram does not count every transfer");
+  if (sum (after.depth, BLOCKSTAT_DEPTHS) != after.reads + after.writes)
+    fail ("queue depth histogram does not count every request");
+  msg ("statistics are consistent");
+
+  /* Overwriting the synced file in place changes no metadata, so
+     a direct write sends exactly its own bytes to the disk. */
+  CHECK ((fd = open_direct (file_name)) > 1, "open_direct \"%s\"",
+         file_name);
+  random_bytes (buf, sizeof buf);
+  for (try = 0; ; try++)
+    {
+      blockstat (fs_index, &before);
+      if (pwrite (fd, buf, sizeof buf, 0) != sizeof buf)
+        fail ("pwrite \"%s\" failed", file_name);
+      blockstat (fs_index, &after);
+      if (after.write_bytes - before.write_bytes == sizeof buf)
+        break;
+      if (try + 1 >= DIRECT_TRIES)
+        fail ("direct write of %zu bytes counted as %"PRIu64" bytes",
+              sizeof buf, after.write_bytes - before.write_bytes);
+    }
+  msg ("direct write counted exactly");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+
+  CHECK (!blockstat (i, &after), "blockstat past last device "
+         "(must return false)");
+  CHECK (!blockstat (-1, &after), "blockstat negative index "
+         "(must return false)");
+}
@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(blockstat) begin
+(blockstat) find file system device
+(blockstat) get statistics
+(blockstat) create "counted"
+(blockstat) open "counted"
+(blockstat) write "counted"
+(blockstat) fsync "counted"
+(blockstat) close "counted"
+(blockstat) get statistics again
+(blockstat) statistics are consistent
+(blockstat) open_direct "counted"
+(blockstat) direct write counted exactly
+(blockstat) close "counted"
+(blockstat) open "counted" for verification
+(blockstat) verified contents of "counted"
+(blockstat) close "counted"
+(blockstat) blockstat past last device (must return false)
+(blockstat) blockstat negative index (must return false)
+(blockstat) end
+EOF
+pass;
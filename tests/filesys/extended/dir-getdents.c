@@ -0,0 +1,45 @@
+/* Lists a directory with getdents() and checks that each entry
+   comes back with the right name, inode number and type. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buffer[512];
+  int dir_fd, file_fd, sub_fd;
+  int file_ino, sub_ino;
+  int size, ofs;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (create ("d/f", 0), "create \"d/f\"");
+  CHECK (mkdir ("d/s"), "mkdir \"d/s\"");
+  CHECK ((file_fd = open ("d/f")) > 1, "open \"d/f\"");
+  CHECK ((sub_fd = open ("d/s")) > 1, "open \"d/s\"");
+  file_ino = inumber (file_fd);
+  sub_ino = inumber (sub_fd);
+  close (file_fd);
+  close (sub_fd);
+
+  CHECK ((dir_fd = open ("d")) > 1, "open \"d\"");
+  size = getdents (dir_fd, buffer, sizeof buffer);
+  CHECK (size > 0, "getdents \"d\"");
+  for (ofs = 0; ofs < size; )
+    {
+      struct dirent *d = (struct dirent *) (buffer + ofs);
+      int expected_ino = !strcmp (d->d_name, "f") ? file_ino : sub_ino;
+
+      if (d->d_ino != expected_ino)
+        fail ("%s: inumber %d, expected %d",
+              d->d_name, d->d_ino, expected_ino);
+      msg ("entry \"%s\" is a %s", d->d_name,
+           d->d_type == DT_DIR ? "directory" : "file");
+      ofs += d->d_reclen;
+    }
+  CHECK (getdents (dir_fd, buffer, sizeof buffer) == 0,
+         "getdents \"d\" at end of directory");
+  close (dir_fd);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-getdents) begin
+(dir-getdents) mkdir "d"
+(dir-getdents) create "d/f"
+(dir-getdents) mkdir "d/s"
+(dir-getdents) open "d/f"
+(dir-getdents) open "d/s"
+(dir-getdents) open "d"
+(dir-getdents) getdents "d"
+(dir-getdents) entry "f" is a file
+(dir-getdents) entry "s" is a directory
+(dir-getdents) getdents "d" at end of directory
+(dir-getdents) end
+EOF
+pass;
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($bytes) = random_bytes (11000);
+my ($data) = (substr ($bytes, 0, 1000) . substr ($bytes, 9000, 2000)
+	      . substr ($bytes, 3000, 6000));
+check_archive ({"stream" => [$data]});
+pass;
@@ -0,0 +1,46 @@
+/* Writes a file through a descriptor opened with open_direct(),
+   in pieces that do not line up with sector boundaries, and
+   verifies it through an ordinary descriptor.  Then overwrites
+   part of it through an ordinary descriptor and verifies it
+   through a direct one while the new data may still be only in
+   the buffer cache. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[9000];
+static const size_t sizes[] = {100, 4096, 1500, 3304};
+
+void
+test_main (void)
+{
+  const char *file_name = "stream";
+  size_t ofs, i;
+  int fd, direct_fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open_direct (file_name)) > 1, "open_direct \"%s\"",
+         file_name);
+  msg ("write \"%s\" in unaligned pieces", file_name);
+  for (ofs = i = 0; i < sizeof sizes / sizeof *sizes; ofs += sizes[i++])
+    if (write (fd, buf + ofs, sizes[i]) != (int) sizes[i])
+      fail ("write %zu bytes at offset %zu failed", sizes[i], ofs);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf + 1000, 2000);
+  seek (fd, 1000);
+  CHECK (write (fd, buf + 1000, 2000) == 2000, "overwrite \"%s\"",
+         file_name);
+  CHECK ((direct_fd = open_direct (file_name)) > 1,
+         "open_direct \"%s\" for verification", file_name);
+  check_file_handle (direct_fd, file_name, buf, sizeof buf);
+  msg ("close \"%s\"", file_name);
+  close (direct_fd);
+  close (fd);
+}
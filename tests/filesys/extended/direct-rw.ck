@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(direct-rw) begin
+(direct-rw) create "stream"
+(direct-rw) open_direct "stream"
+(direct-rw) write "stream" in unaligned pieces
+(direct-rw) close "stream"
+(direct-rw) open "stream" for verification
+(direct-rw) verified contents of "stream"
+(direct-rw) close "stream"
+(direct-rw) open "stream"
+(direct-rw) overwrite "stream"
+(direct-rw) open_direct "stream" for verification
+(direct-rw) verified contents of "stream"
+(direct-rw) close "stream"
+(direct-rw) end
+EOF
+pass;
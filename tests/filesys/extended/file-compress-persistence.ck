@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($text) = join ('', map (sprintf ("%05d compressible line of log text %4d\n",
+				     $_, $_ % 7), 0...499));
+check_archive ({"packed" => [substr ($text, 0, 8000) . random_bytes (1000)
+			     . substr ($text, 9000, 6000)]});
+pass;
@@ -0,0 +1,84 @@
+/* Writes log-like text to a compressed file, checking that it
+   takes up fewer sectors than the same text written to an
+   ordinary file, overwrites part of it with random data, shrinks
+   it with ftruncate(), and checks that it reads back correctly
+   after being closed. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LINE_LEN 41
+#define LINE_CNT 500
+
+static char buf[LINE_LEN * LINE_CNT + 1];
+
+/* Returns the number of free sectors on the file system.  Only
+   allocations change it, so it does not depend on when dirty
+   sectors happen to be written back. */
+static uint64_t
+free_sectors (void)
+{
+  struct fsstat st;
+
+  if (!fsstat (&st))
+    fail ("fsstat failed");
+  return st.free_sectors;
+}
+
+/* Writes BUF to new file FILE_NAME, compressed if COMPRESS is
+   true, syncs it, and returns the number of sectors the data
+   took up.  Leaves the file open as *FD. */
+static uint64_t
+write_synced (const char *file_name, bool compress, int *fd)
+{
+  uint64_t start;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((*fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  if (compress)
+    CHECK (fcompress (*fd), "fcompress \"%s\"", file_name);
+  start = free_sectors ();
+  CHECK (write (*fd, buf, LINE_LEN * LINE_CNT) == LINE_LEN * LINE_CNT,
+         "write \"%s\"", file_name);
+  CHECK (fsync (*fd), "fsync \"%s\"", file_name);
+  return start - free_sectors ();
+}
+
+void
+test_main (void)
+{
+  const char *file_name = "packed";
+  uint64_t plain_sectors, packed_sectors;
+  int fd;
+  int i;
+
+  for (i = 0; i < LINE_CNT; i++)
+    snprintf (buf + i * LINE_LEN, LINE_LEN + 1,
+              "%05d compressible line of log text %4d\n", i, i % 7);
+
+  plain_sectors = write_synced ("plain", false, &fd);
+  msg ("close \"plain\"");
+  close (fd);
+  CHECK (remove ("plain"), "remove \"plain\"");
+
+  packed_sectors = write_synced (file_name, true, &fd);
+  if (packed_sectors * 2 > plain_sectors)
+    fail ("compressed file took up %"PRIu64" sectors, "
+          "ordinary file only %"PRIu64, packed_sectors, plain_sectors);
+  msg ("compressed file took up under half the sectors");
+
+  random_bytes (buf + 8000, 1000);
+  seek (fd, 8000);
+  CHECK (write (fd, buf + 8000, 1000) == 1000,
+         "overwrite \"%s\" with random data", file_name);
+  CHECK (ftruncate (fd, 15000), "shrink \"%s\" to 15000 bytes", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  CHECK (!fcompress (fd), "fcompress closed fd (must return false)");
+  check_file (file_name, buf, 15000);
+}
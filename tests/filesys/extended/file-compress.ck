@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(file-compress) begin
+(file-compress) create "plain"
+(file-compress) open "plain"
+(file-compress) write "plain"
+(file-compress) fsync "plain"
+(file-compress) close "plain"
+(file-compress) remove "plain"
+(file-compress) create "packed"
+(file-compress) open "packed"
+(file-compress) fcompress "packed"
+(file-compress) write "packed"
+(file-compress) fsync "packed"
+(file-compress) compressed file took up under half the sectors
+(file-compress) overwrite "packed" with random data
+(file-compress) shrink "packed" to 15000 bytes
+(file-compress) close "packed"
+(file-compress) fcompress closed fd (must return false)
+(file-compress) open "packed" for verification
+(file-compress) verified contents of "packed"
+(file-compress) close "packed"
+(file-compress) end
+EOF
+pass;
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($src) = random_bytes (5000);
+my ($copy) = substr ($src, 0, 100) . substr ($src, 300, 4000);
+check_archive ({"src" => [$src], "a" => [$copy], "b" => [$src]});
+pass;
@@ -0,0 +1,61 @@
+/* Copies data between files with copy_file_range(), once with the
+   source and destination positions aligned differently within a
+   sector and once with both at the start of a sector, and checks
+   the results. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SRC_SIZE 5000
+
+static char buf[SRC_SIZE];
+static char expected[4100];
+
+void
+test_main (void)
+{
+  int src_fd, dst_fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("src", 0), "create \"src\"");
+  CHECK ((src_fd = open ("src")) > 1, "open \"src\"");
+  CHECK (write (src_fd, buf, sizeof buf) == SRC_SIZE, "write \"src\"");
+
+  /* Unaligned copy into the middle of a new file. */
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK ((dst_fd = open ("a")) > 1, "open \"a\"");
+  CHECK (write (dst_fd, buf, 100) == 100, "write \"a\"");
+  seek (src_fd, 300);
+  CHECK (copy_file_range (src_fd, dst_fd, 4000) == 4000,
+         "copy 4000 bytes from \"src\" to \"a\"");
+  CHECK (tell (src_fd) == 4300 && tell (dst_fd) == 4100,
+         "tell after copy");
+  msg ("close \"a\"");
+  close (dst_fd);
+  memcpy (expected, buf, 100);
+  memcpy (expected + 100, buf + 300, 4000);
+  check_file ("a", expected, sizeof expected);
+
+  /* Aligned copy of a whole file, asking for more than there is. */
+  CHECK (create ("b", 0), "create \"b\"");
+  CHECK ((dst_fd = open ("b")) > 1, "open \"b\"");
+  seek (src_fd, 0);
+  CHECK (copy_file_range (src_fd, dst_fd, 2 * SRC_SIZE) == SRC_SIZE,
+         "copy all of \"src\" to \"b\"");
+  msg ("close \"b\"");
+  close (dst_fd);
+  check_file ("b", buf, sizeof buf);
+
+  /* Overlapping copy within one file. */
+  seek (src_fd, 0);
+  CHECK ((dst_fd = open ("src")) > 1, "open \"src\" again");
+  seek (dst_fd, 1000);
+  CHECK (copy_file_range (src_fd, dst_fd, 2000) == -1,
+         "overlapping copy within \"src\" (must return -1)");
+  close (dst_fd);
+  msg ("close \"src\"");
+  close (src_fd);
+}
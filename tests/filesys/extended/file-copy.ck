@@ -0,0 +1,31 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(file-copy) begin
+(file-copy) create "src"
+(file-copy) open "src"
+(file-copy) write "src"
+(file-copy) create "a"
+(file-copy) open "a"
+(file-copy) write "a"
+(file-copy) copy 4000 bytes from "src" to "a"
+(file-copy) tell after copy
+(file-copy) close "a"
+(file-copy) open "a" for verification
+(file-copy) verified contents of "a"
+(file-copy) close "a"
+(file-copy) create "b"
+(file-copy) open "b"
+(file-copy) copy all of "src" to "b"
+(file-copy) close "b"
+(file-copy) open "b" for verification
+(file-copy) verified contents of "b"
+(file-copy) close "b"
+(file-copy) open "src" again
+(file-copy) overlapping copy within "src" (must return -1)
+(file-copy) close "src"
+(file-copy) end
+EOF
+pass;
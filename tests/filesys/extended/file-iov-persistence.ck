@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($bytes) = random_bytes (4600);
+my ($data) = (substr ($bytes, 0, 2000) . substr ($bytes, 4100, 500)
+	      . substr ($bytes, 2500, 1600));
+check_archive ({"iov" => [$data]});
+pass;
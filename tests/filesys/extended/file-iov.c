@@ -0,0 +1,58 @@
+/* Writes a file with writev(), overwrites part of it with
+   pwrite(), and reads it back with pread() and readv(), using
+   buffers that do not line up with sector boundaries. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 4100
+
+static char buf[FILE_SIZE];
+static char in[FILE_SIZE];
+
+void
+test_main (void)
+{
+  const char *file_name = "iov";
+  struct iovec iov[3];
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 100;
+  iov[1].iov_base = buf + 100;
+  iov[1].iov_len = 1000;
+  iov[2].iov_base = buf + 1100;
+  iov[2].iov_len = 3000;
+  CHECK (writev (fd, iov, 3) == FILE_SIZE, "writev \"%s\"", file_name);
+  CHECK (tell (fd) == FILE_SIZE, "tell \"%s\" after writev", file_name);
+
+  random_bytes (buf + 2000, 500);
+  CHECK (pwrite (fd, buf + 2000, 500, 2000) == 500, "pwrite \"%s\"",
+         file_name);
+  CHECK (tell (fd) == FILE_SIZE, "tell \"%s\" after pwrite", file_name);
+
+  CHECK (pread (fd, in, 700, 1900) == 700, "pread \"%s\"", file_name);
+  compare_bytes (in, buf + 1900, 700, 1900, file_name);
+
+  memset (in, 0, sizeof in);
+  seek (fd, 0);
+  iov[0].iov_base = in;
+  iov[0].iov_len = 2049;
+  iov[1].iov_base = in + 2049;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = in + 2049;
+  iov[2].iov_len = FILE_SIZE;
+  CHECK (readv (fd, iov, 3) == FILE_SIZE, "readv \"%s\"", file_name);
+  compare_bytes (in, buf, FILE_SIZE, 0, file_name);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(file-iov) begin
+(file-iov) create "iov"
+(file-iov) open "iov"
+(file-iov) writev "iov"
+(file-iov) tell "iov" after writev
+(file-iov) pwrite "iov"
+(file-iov) tell "iov" after pwrite
+(file-iov) pread "iov"
+(file-iov) readv "iov"
+(file-iov) close "iov"
+(file-iov) open "iov" for verification
+(file-iov) verified contents of "iov"
+(file-iov) close "iov"
+(file-iov) end
+EOF
+pass;
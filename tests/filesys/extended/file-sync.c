@@ -0,0 +1,31 @@
+/* Writes a file and makes it durable with fsync() and
+   fdatasync(), then checks that syncing a bad descriptor fails. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[3000];
+
+void
+test_main (void)
+{
+  const char *file_name = "synced";
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, 2000) == 2000, "write \"%s\"", file_name);
+  CHECK (fsync (fd), "fsync \"%s\"", file_name);
+  seek (fd, 100);
+  CHECK (write (fd, buf + 100, 1000) == 1000, "overwrite \"%s\"", file_name);
+  CHECK (fdatasync (fd), "fdatasync \"%s\"", file_name);
+  CHECK (write (fd, buf + 1100, 1900) == 1900, "extend \"%s\"", file_name);
+  CHECK (fdatasync (fd), "fdatasync \"%s\" again", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  CHECK (!fsync (fd), "fsync closed fd (must return false)");
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(file-sync) begin
+(file-sync) create "synced"
+(file-sync) open "synced"
+(file-sync) write "synced"
+(file-sync) fsync "synced"
+(file-sync) overwrite "synced"
+(file-sync) fdatasync "synced"
+(file-sync) extend "synced"
+(file-sync) fdatasync "synced" again
+(file-sync) close "synced"
+(file-sync) fsync closed fd (must return false)
+(file-sync) open "synced" for verification
+(file-sync) verified contents of "synced"
+(file-sync) close "synced"
+(file-sync) end
+EOF
+pass;
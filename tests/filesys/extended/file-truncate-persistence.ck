@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($data) = random_bytes (10000);
+check_archive ({"truncated" => [substr ($data, 0, 1000) . "\0" x 2000
+				. substr ($data, 3000, 5000)]});
+pass;
@@ -0,0 +1,40 @@
+/* Shrinks and regrows a file with ftruncate(), reserves space
+   past its end with fallocate(), then writes into that space and
+   checks that the file reads back as expected. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[10000];
+
+void
+test_main (void)
+{
+  const char *file_name = "truncated";
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write \"%s\"", file_name);
+  CHECK (ftruncate (fd, 1000), "shrink \"%s\" to 1000 bytes", file_name);
+  CHECK (filesize (fd) == 1000, "filesize \"%s\" is 1000", file_name);
+  CHECK (ftruncate (fd, 3000), "extend \"%s\" to 3000 bytes", file_name);
+  CHECK (filesize (fd) == 3000, "filesize \"%s\" is 3000", file_name);
+  CHECK (fallocate (fd, 0, 80000), "reserve 80000 bytes of \"%s\"",
+         file_name);
+  CHECK (filesize (fd) == 3000, "filesize \"%s\" is still 3000", file_name);
+  seek (fd, 3000);
+  CHECK (write (fd, buf + 3000, 5000) == 5000,
+         "write reserved space of \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  CHECK (!ftruncate (fd, 0), "ftruncate closed fd (must return false)");
+
+  memset (buf + 1000, 0, 2000);
+  check_file (file_name, buf, 8000);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(file-truncate) begin
+(file-truncate) create "truncated"
+(file-truncate) open "truncated"
+(file-truncate) write "truncated"
+(file-truncate) shrink "truncated" to 1000 bytes
+(file-truncate) filesize "truncated" is 1000
+(file-truncate) extend "truncated" to 3000 bytes
+(file-truncate) filesize "truncated" is 3000
+(file-truncate) reserve 80000 bytes of "truncated"
+(file-truncate) filesize "truncated" is still 3000
+(file-truncate) write reserved space of "truncated"
+(file-truncate) close "truncated"
+(file-truncate) ftruncate closed fd (must return false)
+(file-truncate) open "truncated" for verification
+(file-truncate) verified contents of "truncated"
+(file-truncate) close "truncated"
+(file-truncate) end
+EOF
+pass;
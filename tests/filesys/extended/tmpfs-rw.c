@@ -0,0 +1,45 @@
+/* Writes, reads back and removes files and directories on a
+   tmpfs mounted at /tmp, and walks back out of it with "..".
+   Leaves one file behind in /tmp, which the persistence check,
+   run without the tmpfs, verifies never reached the disk. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[20000];
+
+void
+test_main (void)
+{
+  const char *file_name = "/tmp/scratch";
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+
+  CHECK (mkdir ("/tmp/dir"), "mkdir \"/tmp/dir\"");
+  CHECK (chdir ("/tmp/dir"), "chdir \"/tmp/dir\"");
+  CHECK (create ("inner", 512), "create \"inner\"");
+  CHECK (chdir (".."), "chdir \"..\"");
+  CHECK (!remove ("dir"), "remove \"dir\" (must fail)");
+  CHECK (remove ("dir/inner"), "remove \"dir/inner\"");
+  CHECK (remove ("dir"), "remove \"dir\"");
+  CHECK (chdir (".."), "chdir \"..\"");
+  CHECK ((fd = open ("tmp")) > 1, "open \"tmp\"");
+  CHECK (isdir (fd), "isdir \"tmp\"");
+  msg ("close \"tmp\"");
+  close (fd);
+
+  CHECK (create ("kept", 0), "create \"kept\"");
+  CHECK (remove (file_name), "remove \"%s\"", file_name);
+  CHECK (open (file_name) == -1, "open \"%s\" (must return -1)", file_name);
+  CHECK (create ("/tmp/left", 512), "create \"/tmp/left\"");
+}
@@ -0,0 +1,31 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(tmpfs-rw) begin
+(tmpfs-rw) create "/tmp/scratch"
+(tmpfs-rw) open "/tmp/scratch"
+(tmpfs-rw) write "/tmp/scratch"
+(tmpfs-rw) close "/tmp/scratch"
+(tmpfs-rw) open "/tmp/scratch" for verification
+(tmpfs-rw) verified contents of "/tmp/scratch"
+(tmpfs-rw) close "/tmp/scratch"
+(tmpfs-rw) mkdir "/tmp/dir"
+(tmpfs-rw) chdir "/tmp/dir"
+(tmpfs-rw) create "inner"
+(tmpfs-rw) chdir ".."
+(tmpfs-rw) remove "dir" (must fail)
+(tmpfs-rw) remove "dir/inner"
+(tmpfs-rw) remove "dir"
+(tmpfs-rw) chdir ".."
+(tmpfs-rw) open "tmp"
+(tmpfs-rw) isdir "tmp"
+(tmpfs-rw) close "tmp"
+(tmpfs-rw) create "kept"
+(tmpfs-rw) remove "/tmp/scratch"
+(tmpfs-rw) open "/tmp/scratch" (must return -1)
+(tmpfs-rw) create "/tmp/left"
+(tmpfs-rw) end
+EOF
+pass;
@@ -34,8 +34,12 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
+#include "devices/stripe.h"
+#include "devices/virtio-blk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/tmpfs.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -49,6 +53,25 @@ static bool format_filesys;
    overriding the defaults. */
 static const char *filesys_bdev_name;
 static const char *scratch_bdev_name;
+
+/* -stripe: Comma-separated block devices to stripe, or null.
+   -stripe-size: Sectors per stripe. */
+static const char *stripe_members;
+static block_sector_t stripe_size = STRIPE_DEFAULT_SECTORS;
+
+/* -ramdisk: Size of RAM disk to create in kB, or 0 for none.
+   -ramdisk-load: Preload the RAM disk from the scratch device? */
+static size_t ramdisk_kb;
+static bool ramdisk_load_scratch;
+static struct block *ramdisk;
+
+/* -blktrace: Number of block requests to trace, or 0 for none.
+   -blktrace-scratch: Dump the trace to the scratch device? */
+static size_t blktrace_cnt;
+static bool blktrace_scratch;
+
+/* -tmpfs: Directory to mount a tmpfs over, or null. */
+static const char *tmpfs_dir;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
@@ -67,7 +90,8 @@ static void usage (void);
 
 #ifdef FILESYS
 static void locate_block_devices (void);
-static void locate_block_device (enum block_type, const char *name);
+static void locate_block_device (enum block_type, const char *name,
+                                 struct block *avoid);
 #endif
 
 int main (void) NO_RETURN;
@@ -122,9 +146,30 @@ main (void)
 
 #ifdef FILESYS
   /* Initialize file system. */
+  if (blktrace_cnt > 0)
+    block_trace_init (blktrace_cnt, blktrace_scratch);
   ide_init ();
+  virtio_blk_init ();
+  if (stripe_members != NULL)
+    {
+      /* Use the array for the file system unless told otherwise. */
+      struct block *array = stripe_init (stripe_members, stripe_size);
+      if (filesys_bdev_name == NULL)
+        filesys_bdev_name = block_name (array);
+    }
+  if (ramdisk_kb > 0)
+    ramdisk = ramdisk_init (ramdisk_kb);
   locate_block_devices ();
+  if (ramdisk_load_scratch)
+    {
+      struct block *scratch = block_get_role (BLOCK_SCRATCH);
+      if (ramdisk == NULL || scratch == NULL || scratch == ramdisk)
+        PANIC ("-ramdisk-load needs -ramdisk and a separate scratch device");
+      ramdisk_load (ramdisk, scratch);
+    }
   filesys_init (format_filesys);
+  if (tmpfs_dir != NULL && !tmpfs_mount (tmpfs_dir))
+    PANIC ("can't mount tmpfs on %s", tmpfs_dir);
 #endif
 
   printf ("Boot complete.\n");
@@ -247,6 +292,28 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-ide-large"))
+        ide_allow_large = true;
+      else if (!strcmp (name, "-stripe"))
+        stripe_members = value;
+      else if (!strcmp (name, "-stripe-size"))
+        stripe_size = atoi (value);
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_kb = atoi (value);
+      else if (!strcmp (name, "-ramdisk-load"))
+        ramdisk_load_scratch = true;
+      else if (!strcmp (name, "-tmpfs"))
+        tmpfs_dir = value;
+      else if (!strcmp (name, "-blktrace"))
+        blktrace_cnt = atoi (value);
+      else if (!strcmp (name, "-blktrace-scratch"))
+        blktrace_scratch = true;
+      else if (!strcmp (name, "-iosched"))
+        {
+          if (value == NULL || !block_set_scheduler (value))
+            PANIC ("unknown I/O scheduler `%s' (use -h for help)",
+                   value != NULL ? value : "");
+        }
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -373,6 +440,15 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -ide-large         Use IDE disks of 1 GB or more.\n"
+          "  -stripe=BDEV,...   Stripe BDEVs into md0, used for file system.\n"
+          "  -stripe-size=N     Use N-sector stripes (default 16).\n"
+          "  -ramdisk=KB        Create a KB kB RAM disk named ram0.\n"
+          "  -ramdisk-load      Preload ram0 from the scratch device.\n"
+          "  -tmpfs=DIR         Mount an in-memory file system on DIR.\n"
+          "  -iosched=NAME      Use NAME (clook or deadline) as I/O scheduler.\n"
+          "  -blktrace=N        Trace the last N block requests.\n"
+          "  -blktrace-scratch  Dump block trace to scratch, not console.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
@@ -387,23 +463,30 @@ usage (void)
 }
 
 #ifdef FILESYS
-/* Figure out what block devices to cast in the various Pintos roles. */
+/* Figure out what block devices to cast in the various Pintos roles.
+   Scratch and swap go on a different IDE channel from the file
+   system if they can, so that their I/O proceeds in parallel. */
 static void
 locate_block_devices (void)
 {
-  locate_block_device (BLOCK_FILESYS, filesys_bdev_name);
-  locate_block_device (BLOCK_SCRATCH, scratch_bdev_name);
+  struct block *filesys;
+
+  locate_block_device (BLOCK_FILESYS, filesys_bdev_name, NULL);
+  filesys = block_get_role (BLOCK_FILESYS);
+  locate_block_device (BLOCK_SCRATCH, scratch_bdev_name, filesys);
 #ifdef VM
-  locate_block_device (BLOCK_SWAP, swap_bdev_name);
+  locate_block_device (BLOCK_SWAP, swap_bdev_name, filesys);
 #endif
 }
 
 /* Figures out what block device to use for the given ROLE: the
    block device with the given NAME, if NAME is non-null,
-   otherwise the first block device in probe order of type
-   ROLE. */
+   otherwise the first block device in probe order of type ROLE,
+   preferring one that is not on the same IDE channel as AVOID,
+   if AVOID is non-null. */
 static void
-locate_block_device (enum block_type role, const char *name)
+locate_block_device (enum block_type role, const char *name,
+                     struct block *avoid)
 {
   struct block *block = NULL;
 
@@ -415,9 +498,21 @@ locate_block_device (enum block_type role, const char *name)
     }
   else
     {
-      for (block = block_first (); block != NULL; block = block_next (block))
-        if (block_type (block) == role)
-          break;
+      struct block *candidate;
+
+      for (candidate = block_first (); candidate != NULL;
+           candidate = block_next (candidate))
+        if (block_type (candidate) == role)
+          {
+            if (block == NULL)
+              block = candidate;
+            if (avoid == NULL || ide_channel (candidate) < 0
+                || ide_channel (candidate) != ide_channel (avoid))
+              {
+                block = candidate;
+                break;
+              }
+          }
     }
 
   if (block != NULL)
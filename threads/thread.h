@@ -120,6 +120,7 @@ struct thread
 
   struct dir* cwd;
   struct semaphore c_sema;
+  int journal_depth;            /* Nesting depth of journal_begin(). */
 };
 
 struct donate
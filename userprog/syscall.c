@@ -1,16 +1,24 @@
 #include "userprog/syscall.h"
 #include "userprog/process.h"
+#include <blockstat.h>
+#include <fsstat.h>
 #include <stdio.h>
 #include <syscall-nr.h>
+#include <stdint.h>
 #include <string.h>
+#include <uio.h>
 #include "threads/thread.h"
 #include "threads/init.h"
 #include "threads/malloc.h"
 
+#include "filesys/cache.h"
 #include "filesys/file.h"
+#include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "devices/block.h"
 #include "devices/input.h"
 #include "devices/shutdown.h"
+#include "devices/timer.h"
 
 #define checkARG 	if((uint32_t)esp > 0xc0000000-(argsNum+1)*4) \
   syscall_exit(f,argsNum);
@@ -116,6 +124,34 @@ syscall_handler (struct intr_frame *f)
         break;
     case SYS_INUMBER: syscall_inumber(f, 1);
         break;
+    case SYS_GETDENTS: syscall_getdents(f, 3);
+        break;
+    case SYS_FSSTAT: syscall_fsstat(f, 1);
+        break;
+    case SYS_OPEN_DIRECT: syscall_open_direct(f, 1);
+        break;
+    case SYS_PREAD: syscall_pread(f, 4);
+        break;
+    case SYS_PWRITE: syscall_pwrite(f, 4);
+        break;
+    case SYS_READV: syscall_readv(f, 3);
+        break;
+    case SYS_WRITEV: syscall_writev(f, 3);
+        break;
+    case SYS_COPY_FILE_RANGE: syscall_copy_file_range(f, 3);
+        break;
+    case SYS_FSYNC: syscall_fsync(f, 1);
+        break;
+    case SYS_FDATASYNC: syscall_fdatasync(f, 1);
+        break;
+    case SYS_FTRUNCATE: syscall_ftruncate(f, 2);
+        break;
+    case SYS_FALLOCATE: syscall_fallocate(f, 3);
+        break;
+    case SYS_FCOMPRESS: syscall_fcompress(f, 1);
+        break;
+    case SYS_BLOCKSTAT: syscall_blockstat(f, 2);
+        break;
 
   }	
 }
@@ -475,3 +511,326 @@ void syscall_inumber (struct intr_frame *f, int argsNum)
   f->eax = inumber;
 }
 
+void syscall_getdents (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd = *(int *)(esp+4);
+  void* buffer = *(void **)(esp+8);
+  uint32_t size = *(uint32_t *)(esp+12);
+
+  if((char*)buffer + size > (char*)0xc0000000) syscall_exit(f,-1);
+
+  struct fd_elem *fe = getFD_elem(fd, thread_current());
+  if (!fe || fe->fd % 2 != 0)
+    {
+      f->eax = -1;
+      return;
+    }
+  f->eax = dir_getdents(fe->dir, buffer, size);
+}
+
+void syscall_fsstat (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  struct fsstat *st = *(struct fsstat **)(esp+4);
+  unsigned long long hits, misses;
+
+  if(st == NULL || (char*)(st + 1) > (char*)0xc0000000) syscall_exit(f,-1);
+
+  cache_get_stats(&hits, &misses);
+  st->ticks = timer_ticks();
+  st->block_reads = block_read_cnt(fs_device);
+  st->block_writes = block_write_cnt(fs_device);
+  st->cache_hits = hits;
+  st->cache_misses = misses;
+  st->free_sectors = free_map_free_cnt();
+  f->eax = true;
+}
+
+/* Like open, but reads and writes through the new descriptor
+   bypass the buffer cache.  Directories are opened as usual. */
+void syscall_open_direct (struct intr_frame *f, int argsNum)
+{
+  syscall_open(f, argsNum);
+
+  int fd = (int)f->eax;
+  if(fd != -1 && fd % 2 == 1)
+    file_set_direct(getFile(fd, thread_current()), true);
+}
+
+/* Returns the open file for FD, which must be a file rather than a
+   directory or the console, or a null pointer if there is none. */
+static struct file *lookup_file (int fd)
+{
+  struct fd_elem *fe = getFD_elem(fd, thread_current());
+  if (!fe || fe->fd % 2 == 0)
+    return NULL;
+  return getFile(fd, thread_current());
+}
+
+void syscall_pread (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd = *(int *)(esp+4);
+  char* buffer = *(char **)(esp+8);
+  uint32_t size = *(uint32_t *)(esp+12);
+  uint32_t offset = *(uint32_t *)(esp+16);
+
+  if(buffer + size < buffer || buffer + size > (char*)0xc0000000)
+    syscall_exit(f,-1);
+
+  struct file *file = lookup_file(fd);
+  if (file == NULL || offset > INT32_MAX || size > INT32_MAX - offset)
+  {
+    f->eax = -1;
+    return;
+  }
+  f->eax = file_read_at(file, buffer, size, offset);
+}
+
+void syscall_pwrite (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd = *(int *)(esp+4);
+  const char* buffer = *(const char **)(esp+8);
+  uint32_t size = *(uint32_t *)(esp+12);
+  uint32_t offset = *(uint32_t *)(esp+16);
+
+  if(buffer + size < buffer || buffer + size > (char*)0xc0000000)
+    syscall_exit(f,-1);
+
+  struct file *file = lookup_file(fd);
+  if (file == NULL || offset > INT32_MAX || size > INT32_MAX - offset)
+  {
+    f->eax = -1;
+    return;
+  }
+  f->eax = file_write_at(file, buffer, size, offset);
+}
+
+/* Copies the IOVCNT-element iovec array at UIOV from user memory
+   into KIOV, which must have room for IOV_MAX elements.  Kills the
+   process if the array or any buffer it names is not in user
+   memory.  Returns false if IOVCNT is out of range or the buffers
+   are too big in total. */
+static bool copy_in_iovec (struct intr_frame *f, struct iovec *kiov,
+                           const struct iovec *uiov, int iovcnt)
+{
+  uint32_t total = 0;
+  int i;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return false;
+  if (uiov == NULL || (char*)(uiov + iovcnt) > (char*)0xc0000000)
+    syscall_exit(f,-1);
+
+  memcpy(kiov, uiov, iovcnt * sizeof *kiov);
+  for (i = 0; i < iovcnt; i++)
+  {
+    char *base = kiov[i].iov_base;
+    if (base + kiov[i].iov_len < base
+        || base + kiov[i].iov_len > (char*)0xc0000000)
+      syscall_exit(f,-1);
+    total += kiov[i].iov_len;
+    if (total > INT32_MAX)
+      return false;
+  }
+  return true;
+}
+
+void syscall_readv (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd = *(int *)(esp+4);
+  const struct iovec *uiov = *(const struct iovec **)(esp+8);
+  int iovcnt = *(int *)(esp+12);
+  struct iovec iov[IOV_MAX];
+
+  if (!copy_in_iovec(f, iov, uiov, iovcnt))
+  {
+    f->eax = -1;
+    return;
+  }
+
+  if (fd == 0)
+  {
+    int i, total = 0;
+    for (i = 0; i < iovcnt; i++)
+    {
+      size_t j;
+      for (j = 0; j < iov[i].iov_len; j++)
+        ((char *) iov[i].iov_base)[j] = input_getc();
+      total += iov[i].iov_len;
+    }
+    f->eax = total;
+    return;
+  }
+
+  struct file *file = lookup_file(fd);
+  if (file != NULL)
+    f->eax = file_readv(file, iov, iovcnt);
+  else f->eax = -1;
+}
+
+void syscall_writev (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd = *(int *)(esp+4);
+  const struct iovec *uiov = *(const struct iovec **)(esp+8);
+  int iovcnt = *(int *)(esp+12);
+  struct iovec iov[IOV_MAX];
+
+  if (!copy_in_iovec(f, iov, uiov, iovcnt))
+  {
+    f->eax = -1;
+    return;
+  }
+
+  if (fd == 1)
+  {
+    int i, total = 0;
+    for (i = 0; i < iovcnt; i++)
+    {
+      putbuf(iov[i].iov_base, iov[i].iov_len);
+      total += iov[i].iov_len;
+    }
+    f->eax = total;
+    return;
+  }
+
+  struct file *file = lookup_file(fd);
+  if (file != NULL)
+    f->eax = file_writev(file, iov, iovcnt);
+  else f->eax = -1;
+}
+
+/* Copies up to SIZE bytes from FD_IN to FD_OUT inside the kernel,
+   starting at and advancing each file's position. */
+void syscall_copy_file_range (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd_in = *(int *)(esp+4);
+  int fd_out = *(int *)(esp+8);
+  uint32_t size = *(uint32_t *)(esp+12);
+
+  struct file *in = lookup_file(fd_in);
+  struct file *out = lookup_file(fd_out);
+  if (in == NULL || out == NULL || size > INT32_MAX)
+  {
+    f->eax = -1;
+    return;
+  }
+  f->eax = file_copy(out, in, size);
+}
+
+void syscall_fsync (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd = *(int *)(esp+4);
+
+  struct file *file = lookup_file(fd);
+  if (file != NULL)
+    file_sync(file, false);
+  f->eax = file != NULL;
+}
+
+void syscall_fdatasync (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd = *(int *)(esp+4);
+
+  struct file *file = lookup_file(fd);
+  if (file != NULL)
+    file_sync(file, true);
+  f->eax = file != NULL;
+}
+
+void syscall_ftruncate (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd = *(int *)(esp+4);
+  uint32_t length = *(uint32_t *)(esp+8);
+
+  struct file *file = lookup_file(fd);
+  if (file == NULL || length > INT32_MAX)
+  {
+    f->eax = false;
+    return;
+  }
+  f->eax = file_truncate(file, length);
+}
+
+void syscall_fallocate (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd = *(int *)(esp+4);
+  uint32_t offset = *(uint32_t *)(esp+8);
+  uint32_t len = *(uint32_t *)(esp+12);
+
+  struct file *file = lookup_file(fd);
+  if (file == NULL || offset > INT32_MAX || len > INT32_MAX - offset)
+  {
+    f->eax = false;
+    return;
+  }
+  f->eax = file_allocate(file, offset, len);
+}
+
+void syscall_fcompress (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int fd = *(int *)(esp+4);
+
+  struct file *file = lookup_file(fd);
+  f->eax = file != NULL && file_compress(file);
+}
+
+/* Stores the statistics for the INDEXth block device, counting
+   from 0 in order of registration, into *ST.  Returns false if
+   there are not that many block devices. */
+void syscall_blockstat (struct intr_frame *f, int argsNum)
+{
+  void* esp = f->esp;
+  checkARG
+
+  int index = *(int *)(esp+4);
+  struct blockstat *st = *(struct blockstat **)(esp+8);
+  struct block *block;
+
+  if(st == NULL || (char*)(st + 1) > (char*)0xc0000000) syscall_exit(f,-1);
+
+  for (block = block_first(); block != NULL && index > 0;
+       block = block_next(block))
+    index--;
+  if (block == NULL || index < 0)
+    {
+      f->eax = false;
+      return;
+    }
+  block_get_stats(block, st);
+  f->eax = true;
+}
@@ -25,6 +25,20 @@ void syscall_mkdir(struct intr_frame *f,int argsNum);
 void syscall_readdir(struct intr_frame *f,int argsNum);
 void syscall_isdir(struct intr_frame *f,int argsNum);
 void syscall_inumber(struct intr_frame *f,int argsNum);
+void syscall_getdents(struct intr_frame *f,int argsNum);
+void syscall_fsstat(struct intr_frame *f,int argsNum);
+void syscall_open_direct(struct intr_frame *f,int argsNum);
+void syscall_pread(struct intr_frame *f,int argsNum);
+void syscall_pwrite(struct intr_frame *f,int argsNum);
+void syscall_readv(struct intr_frame *f,int argsNum);
+void syscall_writev(struct intr_frame *f,int argsNum);
+void syscall_copy_file_range(struct intr_frame *f,int argsNum);
+void syscall_fsync(struct intr_frame *f,int argsNum);
+void syscall_fdatasync(struct intr_frame *f,int argsNum);
+void syscall_ftruncate(struct intr_frame *f,int argsNum);
+void syscall_fallocate(struct intr_frame *f,int argsNum);
+void syscall_fcompress(struct intr_frame *f,int argsNum);
+void syscall_blockstat(struct intr_frame *f,int argsNum);
 
 int currentFd(struct thread *cur, bool);
 
@@ -488,4 +488,247 @@ sub max {
     return $max;
 }
 
+# min(@args)
+#
+# Returns the numerically smallest value in @args.
+sub min {
+    my ($min) = $_[0];
+    foreach (@_[1..$#_]) {
+	$min = $_ if $_ < $min;
+    }
+    return $min;
+}
+
+# File system layout constants, which must match filesys/*.c.
+my ($FREE_MAP_SECTOR) = 0;
+my ($ROOT_DIR_SECTOR) = 1;
+my ($JOURNAL_SECTOR) = 2;
+my ($INODE_MAGIC) = 0x494e4f44;
+my ($JOURNAL_MAGIC) = 0x4a524e4c;
+my ($NAME_MAX) = 256;
+my ($DIR_ENTRY_SIZE) = 264;
+my ($ROOT_DIR_ENTRIES) = 16;
+my ($MAX_FILE_SIZE) = 8980480;
+my ($DT_REG, $DT_DIR) = (1, 2);
+
+# make_filesys($file_name, $sectors, [$src_file_name, $dst_file_name]...)
+#
+# Writes to $file_name an image of a freshly formatted Pintos file
+# system $sectors sectors long, as the kernel's -f option would,
+# containing a copy of each host file $src_file_name under the name
+# $dst_file_name.  Directories named in a $dst_file_name are created
+# as needed.  Each file's data is laid out in consecutive sectors.
+sub make_filesys {
+    my ($fs_fn, $sectors, @files) = @_;
+    my (%fs) = (SECTORS => $sectors, NEXT => 0, USED => '', DATA => {});
+
+    # The root directory, then a tree of the files to add.
+    my ($root) = {NAME => '', ISDIR => 1, CHILDREN => [],
+		  SECTOR => $ROOT_DIR_SECTOR, PARENT => $ROOT_DIR_SECTOR};
+    foreach my $file (@files) {
+	my ($src_fn, $dst_fn) = @$file;
+	my (@parts) = grep ($_ ne '', split ('/', $dst_fn));
+	die "$dst_fn: invalid file name\n"
+	  if !@parts || grep ($_ eq '.' || $_ eq '..', @parts);
+	my ($dir) = $root;
+	while (@parts) {
+	    my ($name) = shift (@parts);
+	    die "$dst_fn: name component too long\n"
+	      if length ($name) > $NAME_MAX;
+	    my ($child) = grep ($_->{NAME} eq $name, @{$dir->{CHILDREN}});
+	    if (@parts) {
+		if (!defined $child) {
+		    $child = {NAME => $name, ISDIR => 1, CHILDREN => []};
+		    push (@{$dir->{CHILDREN}}, $child);
+		}
+		die "$dst_fn: \"$name\" is not a directory\n"
+		  if !$child->{ISDIR};
+		$dir = $child;
+	    } else {
+		die "$dst_fn: duplicate file name\n" if defined $child;
+		my ($size) = -s $src_fn;
+		die "$src_fn: not a regular file\n" if !-f $src_fn;
+		die "$src_fn: too large for Pintos file system\n"
+		  if $size > $MAX_FILE_SIZE;
+		push (@{$dir->{CHILDREN}},
+		      {NAME => $name, ISDIR => 0, SRC => $src_fn,
+		       SIZE => $size});
+	    }
+	}
+    }
+
+    # Same order as do_format(): reserved sectors, free map, root
+    # directory, journal.
+    fs_alloc (\%fs, 3);
+    my ($free_map_bytes) = 4 * div_round_up ($sectors, 32);
+    my ($free_map) = fs_alloc_inode_data (\%fs, $free_map_bytes);
+    my ($root_entries) = max ($ROOT_DIR_ENTRIES,
+			      scalar (@{$root->{CHILDREN}}));
+    fs_write_dir (\%fs, $root, $root_entries);
+    my ($journal_size) = int ($sectors / 16);
+    $journal_size = 64 if $journal_size < 64;
+    $journal_size = 1024 if $journal_size > 1024;
+    my ($journal_start) = fs_alloc (\%fs, $journal_size);
+    fs_put (\%fs, $JOURNAL_SECTOR,
+	    pack ("V5", $JOURNAL_MAGIC, $journal_start, $journal_size, 0, 1));
+
+    # Files and directories.
+    fs_write_children (\%fs, $root);
+
+    # The free map goes last, once every sector is allocated.
+    my ($bitmap) = $fs{USED};
+    $bitmap .= "\0" x ($free_map_bytes - length ($bitmap));
+    fs_write_inode (\%fs, $FREE_MAP_SECTOR, $free_map, $bitmap, 0,
+		    $ROOT_DIR_SECTOR);
+
+    # Write the image.
+    my ($handle);
+    open ($handle, '>', $fs_fn) or die "$fs_fn: create: $!\n";
+    my ($pos) = 0;
+    foreach my $sector (sort { $a <=> $b } keys %{$fs{DATA}}) {
+	write_zeros ($handle, $fs_fn, ($sector - $pos) * 512);
+	write_fully ($handle, $fs_fn, $fs{DATA}{$sector});
+	$pos = $sector + 1;
+    }
+    write_zeros ($handle, $fs_fn, ($sectors - $pos) * 512);
+    close ($handle) or die "$fs_fn: close: $!\n";
+}
+
+# fs_alloc(\%fs, $cnt)
+#
+# Allocates $cnt consecutive sectors in %fs and returns the first.
+sub fs_alloc {
+    my ($fs, $cnt) = @_;
+    my ($start) = $fs->{NEXT};
+    die "file system too small for its contents\n"
+      if $start + $cnt > $fs->{SECTORS};
+    vec ($fs->{USED}, $_, 1) = 1 foreach $start...$start + $cnt - 1;
+    $fs->{NEXT} += $cnt;
+    return $start;
+}
+
+# fs_put(\%fs, $sector, $data)
+#
+# Sets the contents of $sector in %fs to $data, padded with zeros to
+# a full sector.
+sub fs_put {
+    my ($fs, $sector, $data) = @_;
+    die if length ($data) > 512;
+    $fs->{DATA}{$sector} = pack ("a512", $data);
+}
+
+# fs_alloc_inode_data(\%fs, $length)
+#
+# Allocates the data sectors for an inode $length bytes long, all in a
+# row, followed by the indirect blocks that point to them.  Returns a
+# reference to a hash describing the allocation, for fs_write_inode().
+sub fs_alloc_inode_data {
+    my ($fs, $length) = @_;
+    my ($cnt) = div_round_up ($length, 512);
+    my ($start) = fs_alloc ($fs, $cnt);
+    my (@data) = map ($start + $_, 0...$cnt - 1);
+    my (@ptr) = (0) x 10;
+    my ($i_dir, $i_indir, $i_doubly);
+
+    # Direct blocks.
+    @ptr[0...$#data] = @data if @data <= 8;
+    @ptr[0...7] = @data[0...7] if @data > 8;
+
+    # Indirect block.
+    if (@data > 8) {
+	my (@entries) = @data[8...min (135, $#data)];
+	$ptr[8] = fs_alloc ($fs, 1);
+	fs_put ($fs, $ptr[8], pack ("V*", @entries));
+    }
+
+    # Doubly indirect block.
+    if (@data > 136) {
+	my (@inner);
+	for (my ($i) = 136; $i < @data; $i += 128) {
+	    my (@entries) = @data[$i...min ($i + 127, $#data)];
+	    my ($sector) = fs_alloc ($fs, 1);
+	    fs_put ($fs, $sector, pack ("V*", @entries));
+	    push (@inner, $sector);
+	}
+	$ptr[9] = fs_alloc ($fs, 1);
+	fs_put ($fs, $ptr[9], pack ("V*", @inner));
+    }
+
+    # Where inode_expand() would continue growing the inode.
+    if ($cnt <= 8) {
+	($i_dir, $i_indir, $i_doubly) = ($cnt, 0, 0);
+    } elsif ($cnt < 136) {
+	($i_dir, $i_indir, $i_doubly) = (8, $cnt - 8, 0);
+    } else {
+	($i_dir, $i_indir, $i_doubly)
+	  = (9, int (($cnt - 136) / 128), ($cnt - 136) % 128);
+    }
+
+    return {LENGTH => $length, DATA => \@data, PTR => \@ptr,
+	    I_DIR => $i_dir, I_INDIR => $i_indir, I_DOUBLY => $i_doubly};
+}
+
+# fs_write_inode(\%fs, $sector, $alloc, $contents, $isdir, $parent)
+#
+# Writes an inode to $sector describing the data allocated as $alloc
+# by fs_alloc_inode_data(), and writes $contents to its data sectors.
+sub fs_write_inode {
+    my ($fs, $sector, $alloc, $contents, $isdir, $parent) = @_;
+    my ($inode) = (pack ("V l< V", $parent, $alloc->{LENGTH}, $INODE_MAGIC)
+		   . "\0" x (111 * 4)
+		   . pack ("V10", @{$alloc->{PTR}})
+		   . pack ("C x3 l< l< l<", $isdir ? 1 : 0, $alloc->{I_DIR},
+			   $alloc->{I_INDIR}, $alloc->{I_DOUBLY}));
+    die if length ($inode) != 512;
+    fs_put ($fs, $sector, $inode);
+
+    my (@data) = @{$alloc->{DATA}};
+    for my $i (0...$#data) {
+	fs_put ($fs, $data[$i], substr ($contents, $i * 512, 512));
+    }
+}
+
+# fs_write_dir(\%fs, $dir, $entry_cnt)
+#
+# Allocates space for $entry_cnt entries in directory $dir, whose
+# inode sector is already assigned, and writes its inode and entries.
+# The entries' inode sectors are assigned as a side effect.
+sub fs_write_dir {
+    my ($fs, $dir, $entry_cnt) = @_;
+    my ($contents) = '';
+    foreach my $child (@{$dir->{CHILDREN}}) {
+	$child->{SECTOR} = fs_alloc ($fs, 1);
+	$child->{PARENT} = $dir->{SECTOR};
+	$contents .= pack ("V a257 C C x", $child->{SECTOR}, $child->{NAME},
+			   1, $child->{ISDIR} ? $DT_DIR : $DT_REG);
+    }
+    my ($alloc) = fs_alloc_inode_data ($fs, $entry_cnt * $DIR_ENTRY_SIZE);
+    fs_write_inode ($fs, $dir->{SECTOR}, $alloc, $contents, 1,
+		    $dir->{PARENT});
+}
+
+# fs_write_children(\%fs, $dir)
+#
+# Writes the files and subdirectories of directory $dir, recursively.
+sub fs_write_children {
+    my ($fs, $dir) = @_;
+    foreach my $child (@{$dir->{CHILDREN}}) {
+	if ($child->{ISDIR}) {
+	    fs_write_dir ($fs, $child, scalar (@{$child->{CHILDREN}}));
+	    fs_write_children ($fs, $child);
+	} else {
+	    my ($handle);
+	    my ($fn) = $child->{SRC};
+	    open ($handle, '<', $fn) or die "$fn: open: $!\n";
+	    binmode ($handle);
+	    my ($contents) = read_fully ($handle, $fn, $child->{SIZE});
+	    close ($handle) or die "$fn: close: $!\n";
+
+	    my ($alloc) = fs_alloc_inode_data ($fs, $child->{SIZE});
+	    fs_write_inode ($fs, $child->{SECTOR}, $alloc, $contents, 0,
+			    $child->{PARENT});
+	}
+    }
+}
+
 1;